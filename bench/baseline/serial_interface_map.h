@@ -0,0 +1,96 @@
+// Delft Mercurians
+// 2026-10-19
+
+// Baseline for bench_serial.cpp: SerialInterface as it was before the direct-indexed command
+// table (std::map of commands with String help texts), renamed to MapSerialInterface
+
+#pragma once
+#include <map>
+#include <Arduino.h>
+#if __has_include("../../libversion.h")
+    #include "../../libversion.h"
+#endif
+
+
+class MapSerialInterface {
+    public:
+        MapSerialInterface(Stream* s = nullptr, char name = 'm');
+
+        void initFuns();
+
+        void add(char command, void (*function) (char*), String help = "");
+        void add(char command, void (*function) (float), String help = "");
+        void add(char command, void (*function) (int), String help = "");
+        void add(char command, float*, String help = "");
+        void add(char command, int*, String help = "");
+        // void add(char command, void (*function) (float*, size_t), String help = "");
+
+        void add(char command, void (MapSerialInterface::*) (char*), MapSerialInterface*, String help = "");
+        void add(char command, MapSerialInterface*, String help = "");
+        void run(char* c);
+        void run();
+        
+    protected:
+        void printHelp(char* c);
+        void printHelp(String indentation = "");
+        std::map<char, String> help_map;
+
+        void readFloatAndRun(char* c, void (*function) (float));
+        // void readFloatsAndRun(char* c, void (*function) (float*, size_t));
+        void readIntAndRun(char* c, void (*function) (int));
+
+        template<typename T>
+        void handleValue(char *c, T* v);
+
+        template<typename T>
+        void printValue(T v);
+
+        template<typename T>
+        void setValue(char *c, T* v);
+
+    private:
+        Stream* s;
+
+        char buffer[50];
+        size_t bufi;
+
+        bool isTerminator(char c);
+
+        char name;
+
+        static void echo(char* c);
+
+        enum class FunctionType {
+            CharPointer,
+            Member_CharPointer,
+            Float,
+            Int,
+            SetFloat,
+            SetInt,
+            // FloatPointer,
+        };
+
+        struct Function {
+            FunctionType typ;
+            union {
+                void (*fun_charptr) (char*);
+                void (MapSerialInterface::*fun_member_charptr) (char*);
+                void (*fun_float) (float);
+                void (*fun_int) (int);
+                float* ref_float;
+                int* ref_int;
+                // void (*fun_floatptr) (float*, size_t);
+            };
+            String help;
+            MapSerialInterface* si;
+            bool subcommand;
+        };
+
+        std::map<char, Function> fun_map;
+
+        static void printVersion(char* c);
+        static void printProtocolVersion(char* c);
+
+
+
+};
\ No newline at end of file
@@ -0,0 +1,60 @@
+#include <benchmark/benchmark.h>
+#include "can/can_codec.h"
+
+using namespace CAN;
+
+// Build an ID for every device and variable access, and split it again
+static void BM_CanIdRoundTrip(benchmark::State& state) {
+    for(auto _ : state) {
+        for(uint8_t device = 0; device < CAN_NUM_DEVICE_IDS; device++) {
+            for(uint8_t variable = 0; variable <= (uint8_t) VARIABLE::MASK; variable++) {
+                benchmark::DoNotOptimize(variable);
+                MESSAGE_ID message = generateMessageId((VARIABLE) variable, ACCESS::WRITE);
+                uint16_t id = makeId((DEVICE_ID) device, message);
+                benchmark::DoNotOptimize(getDeviceId(id));
+                benchmark::DoNotOptimize(getVariable(getMessageId(id)));
+                benchmark::DoNotOptimize(getAccess(getMessageId(id)));
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * CAN_NUM_DEVICE_IDS * ((uint8_t) VARIABLE::MASK + 1));
+}
+BENCHMARK(BM_CanIdRoundTrip);
+
+template<typename T>
+static void BM_CanEncodeDecode(benchmark::State& state) {
+    STM32::CAN::msg_t frame = {};
+    T payload = {};
+    T decoded = {};
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(payload);
+        encode(frame, DEVICE_ID::DRIVER_0, payload);
+        benchmark::DoNotOptimize(frame);    // The frame has to be written, not forwarded to decode
+        benchmark::ClobberMemory();
+        benchmark::DoNotOptimize(decode(frame, decoded));
+        benchmark::DoNotOptimize(decoded);
+    }
+}
+BENCHMARK_TEMPLATE(BM_CanEncodeDecode, SyncMessage);
+BENCHMARK_TEMPLATE(BM_CanEncodeDecode, EncoderFeedback);
+
+static float speeds[8];
+static void onEncoder(DEVICE_ID device, const EncoderFeedback& feedback) { speeds[(uint8_t) device] = feedback.speed; }
+
+// Encoder feedback of the four wheel drivers and the dribbler, decoded into their speeds
+static void BM_CanDispatch(benchmark::State& state) {
+    static constexpr DEVICE_ID DRIVERS[] = {DEVICE_ID::DRIVER_0, DEVICE_ID::DRIVER_1, DEVICE_ID::DRIVER_2, DEVICE_ID::DRIVER_3, DEVICE_ID::DRIVER_A};
+    Dispatcher<> dispatcher;
+    dispatcher.on<EncoderFeedback>(onEncoder);
+    STM32::CAN::msg_t frames[5] = {};
+    for(uint8_t i = 0; i < 5; i++) encode(frames[i], DRIVERS[i], EncoderFeedback{DRIVERS[i], 10.0f * i});
+    for(auto _ : state) {
+        for(const STM32::CAN::msg_t& frame : frames) {
+            benchmark::DoNotOptimize(frame);
+            benchmark::DoNotOptimize(dispatcher.dispatch(frame));
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * 5);    // Frames
+}
+BENCHMARK(BM_CanDispatch);
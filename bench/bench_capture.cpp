@@ -0,0 +1,92 @@
+#include <benchmark/benchmark.h>
+#include <vector>
+#include "radio/capture.h"
+
+// A two hour capture of a match: a Command to each of 11 robots at 60 Hz and a PrimaryStatusHF
+// back, with robot 15 only on the field for the first minute. 9.5 million records, 456 MB.
+static constexpr uint32_t CAPTURE_SECONDS = 2 * 3600;
+static constexpr uint32_t CAPTURE_ROBOTS = 11;
+static constexpr uint32_t CAPTURE_RATE = 60;    // [Hz] Per robot and direction
+static constexpr Radio::SSL_ID RARE_ROBOT = 15;
+
+static std::vector<uint8_t>* sink_records;
+static std::vector<uint8_t>* sink_index;
+static size_t appendRecords(const uint8_t* data, size_t len) { sink_records->insert(sink_records->end(), data, data + len); return len; }
+static size_t appendIndex(const uint8_t* data, size_t len) { sink_index->insert(sink_index->end(), data, data + len); return len; }
+
+struct TestCapture {
+    std::vector<uint8_t> records;
+    std::vector<uint8_t> index;
+    std::vector<uint8_t> index_lost;   // With the entry of block 10 missing, as after a failed write
+
+    TestCapture() {
+        records.reserve((size_t) CAPTURE_SECONDS * CAPTURE_RATE * (2 * CAPTURE_ROBOTS + 1) * sizeof(Capture::Record));
+        sink_records = &records;
+        sink_index = &index;
+        Capture::Writer writer(appendRecords, appendIndex);
+        writer.begin();
+        uint32_t period_us = 1000000 / CAPTURE_RATE;
+        for(uint32_t t = 0; t < CAPTURE_SECONDS * CAPTURE_RATE; t++) {
+            uint32_t now = t * period_us;
+            for(Radio::SSL_ID id = 0; id < CAPTURE_ROBOTS; id++) {
+                writer.write(now + id * 1000, Capture::Direction::TX, 0, id, Radio::Message{Radio::Command{}});
+                writer.write(now + id * 1000 + 500, Capture::Direction::RX, 0, id, Radio::Message{Radio::PrimaryStatusHF{}});
+            }
+            if(t < 60 * CAPTURE_RATE) writer.write(now + CAPTURE_ROBOTS * 1000, Capture::Direction::RX, 0, RARE_ROBOT, Radio::Message{Radio::PrimaryStatusHF{}});
+        }
+        writer.end();
+
+        size_t lost = sizeof(Capture::FileHeader) + 10 * sizeof(Capture::IndexEntry);
+        index_lost = index;
+        index_lost.erase(index_lost.begin() + lost, index_lost.begin() + lost + sizeof(Capture::IndexEntry));
+    }
+
+    Capture::Reader reader(bool lost_entry = false) const {
+        const std::vector<uint8_t>& i = lost_entry ? index_lost : index;
+        return Capture::Reader(records.data(), records.size(), i.data(), i.size());
+    }
+};
+
+static const TestCapture& capture() {
+    static TestCapture c;
+    return c;
+}
+
+static volatile uint32_t consumed = 0;
+static void consume(Radio::Message msg, Radio::SSL_ID id) {
+    if(msg.mt == Radio::MessageType::PrimaryStatusHF) consumed = consumed + id;
+}
+
+// Every received message of the capture into a base station style consumer
+static void BM_CaptureReplay(benchmark::State& state) {
+    Capture::Reader reader = capture().reader();
+    for(auto _ : state) {
+        reader.replayReceived(0, reader.count(), consume);
+    }
+    state.SetItemsProcessed(state.iterations() * reader.count());
+    state.SetBytesProcessed(state.iterations() * reader.count() * sizeof(Capture::Record));
+    state.counters["records"] = reader.count();
+}
+BENCHMARK(BM_CaptureReplay)->Unit(benchmark::kMillisecond);
+
+static void BM_CaptureSeekTime(benchmark::State& state) {
+    Capture::Reader reader = capture().reader();
+    uint64_t end_us = reader[reader.count() - 1].time_us;
+    uint64_t t = 0;
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(reader.seekTime(t));
+        t = (t + 7919 * 1000003ULL) % end_us;
+    }
+}
+BENCHMARK(BM_CaptureSeekTime);
+
+// Past the last record of a robot that left: every block is skipped on the index
+static void BM_CaptureSeekRobot(benchmark::State& state) {
+    Capture::Reader reader = capture().reader(state.range(0));
+    uint32_t from = reader.seekTime(61ULL * 1000000);
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(reader.seekRobot(from, RARE_ROBOT));
+    }
+    state.SetItemsProcessed(state.iterations() * (reader.count() - from));
+}
+BENCHMARK(BM_CaptureSeekRobot)->ArgName("lost_entry")->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
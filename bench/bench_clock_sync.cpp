@@ -0,0 +1,140 @@
+#include <benchmark/benchmark.h>
+#include <math.h>
+#include "can/can_clock_sync.h"
+#include "can/virtual_can.h"
+
+using namespace CAN;
+
+// Clock synchronisation of 4 drivers on the virtual bus, next to the wheel control traffic of
+// CAN::BusLoad::Example. The bus time is the primary clock. Driver clocks have an offset and a
+// drift, and every timestamp taken in an interrupt gets a random latency of up to 2 us.
+
+static constexpr uint8_t NUM_DRIVERS = 4;
+static constexpr uint64_t SETTLE_NS = 2000000000ull;   // Errors are measured after this
+
+static uint32_t xorshift(uint32_t& x) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+class SyncPrimary : public Virtual::Node {
+    public:
+        SyncPrimary(uint32_t period_us) : period_ns{(uint64_t) period_us * 1000} { }
+
+        uint64_t tick(Virtual::Bus&, uint64_t now_ns) override {
+            if(!send(master.makeSync(CAN_SYNC_FLAG_SAMPLE), now_ns)) master.onSyncFailed();
+            return now_ns + period_ns;
+        }
+
+        void transmitted(Virtual::Bus&, const STM32::CAN::msg_t& frame, uint64_t, uint64_t now_ns) override {
+            if(getMessageId(frame.id) == MESSAGE_ID::SYNC) master.onSyncTransmitted((now_ns + xorshift(random) % 2000) / 1000);
+        }
+
+    private:
+        SyncMaster master;
+        uint64_t period_ns;
+        uint32_t random = 0x1234567;
+};
+
+class SyncDriver : public Virtual::Node {
+    public:
+        SyncDriver(uint8_t index, float drift_ppm)
+            : offset_ns{(uint64_t) (index + 1) * 123456789ull}, drift{(index % 2 ? -1 : 1) * drift_ppm * 1e-6f * (index + 1) / NUM_DRIVERS},
+              random{0x9E3779B9u * (index + 1)}
+        { }
+
+        uint32_t localMicros(uint64_t now_ns) const {
+            return (uint32_t) ((offset_ns + now_ns + (int64_t) (drift * (double) now_ns)) / 1000);
+        }
+
+        void receive(Virtual::Bus&, const STM32::CAN::msg_t& frame, uint64_t now_ns) override {
+            SyncMessage sync;
+            if(getMessageId(frame.id) != MESSAGE_ID::SYNC || !decode(frame, sync)) return;
+            sync_clock.onSync(sync, localMicros(now_ns + xorshift(random) % 2000));
+        }
+
+        ClockSync sync_clock;
+
+    private:
+        uint64_t offset_ns;
+        float drift;
+        uint32_t random;
+};
+
+// Compares the primary time every driver reports with the bus time, every 100 us
+class Probe : public Virtual::Node {
+    public:
+        Probe(SyncDriver* drivers) : drivers{drivers} { }
+
+        uint64_t tick(Virtual::Bus&, uint64_t now_ns) override {
+            if(now_ns >= SETTLE_NS) {
+                int32_t lo = INT32_MAX, hi = INT32_MIN;
+                for(uint8_t d = 0; d < NUM_DRIVERS; d++) {
+                    SyncDriver& driver = drivers[d];
+                    if(!driver.sync_clock.synchronised()) {
+                        unsynchronised++;
+                        continue;
+                    }
+                    int32_t error = (int32_t) (driver.sync_clock.toPrimary(driver.localMicros(now_ns)) - (uint32_t) (now_ns / 1000));
+                    samples++;
+                    sum += error;
+                    sum_squares += (double) error * error;
+                    if(abs(error) > max_error) max_error = abs(error);
+                    if(error < lo) lo = error;
+                    if(error > hi) hi = error;
+                }
+                if(hi >= lo && hi - lo > max_spread) max_spread = hi - lo;
+            }
+            return now_ns + 100000;
+        }
+
+        uint32_t samples = 0;
+        uint32_t unsynchronised = 0;
+        double sum = 0;
+        double sum_squares = 0;
+        int32_t max_error = 0;
+        int32_t max_spread = 0;     // Between the drivers at the same time
+
+    private:
+        SyncDriver* drivers;
+};
+
+// SYNC period [ms] and the largest driver drift [ppm] as arguments, 10 simulated seconds
+static void BM_CanClockSync(benchmark::State& state) {
+    uint32_t period_us = state.range(0) * 1000;
+    float drift_ppm = state.range(1);
+    Probe result(nullptr);
+    for(auto _ : state) {
+        Virtual::Bus bus(STM32::CAN::CAN_1000kbps);
+        SyncPrimary primary(period_us);
+        SyncDriver drivers[NUM_DRIVERS] = {{0, drift_ppm}, {1, drift_ppm}, {2, drift_ppm}, {3, drift_ppm}};
+        Probe probe(drivers);
+        Virtual::ScheduleNode traffic[5];
+        for(uint8_t i = 0; i < 5; i++) {
+            traffic[i] = Virtual::ScheduleNode(BusLoad::Example::CONTROL_800HZ[i], i, i + 1);
+            bus.attach(traffic[i]);
+        }
+        bus.attach(primary);
+        for(SyncDriver& d : drivers) bus.attach(d);
+        bus.attach(probe);
+        bus.run(10000000000ull);
+
+        result.samples += probe.samples;
+        result.unsynchronised += probe.unsynchronised;
+        result.sum += probe.sum;
+        result.sum_squares += probe.sum_squares;
+        if(probe.max_error > result.max_error) result.max_error = probe.max_error;
+        if(probe.max_spread > result.max_spread) result.max_spread = probe.max_spread;
+    }
+    double mean = result.samples == 0 ? 0 : result.sum / result.samples;
+    state.counters["error_mean_us"] = mean;
+    state.counters["jitter_us"] = result.samples == 0 ? 0 : sqrt(result.sum_squares / result.samples - mean * mean);
+    state.counters["error_max_us"] = result.max_error;
+    state.counters["spread_max_us"] = result.max_spread;
+    state.counters["unsynchronised"] = result.unsynchronised;
+}
+BENCHMARK(BM_CanClockSync)->ArgNames({"period_ms", "drift_ppm"})
+    ->Args({10, 0})->Args({10, 100})->Args({100, 100})->Args({10, 400})
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,85 @@
+#include <benchmark/benchmark.h>
+#include "radio/radio.h"
+#include "radio/flash_emulator.h"
+
+// The flash is emulated in RAM, so the times are the CPU side only. Erases and programmed bytes
+// per iteration are counted, multiply them by the erase and program times of the MCU for the rest.
+
+struct FlashCounts {
+    uint32_t erases;
+    uint32_t programmed;
+
+    FlashCounts(const Radio::FlashEmulator& flash) : erases{flash.eraseCount(0) + flash.eraseCount(1)}, programmed{flash.programmedBytes()} { }
+
+    // Per iteration since construction
+    void report(benchmark::State& state, const Radio::FlashEmulator& flash) const {
+        FlashCounts now(flash);
+        state.counters["erases"] = benchmark::Counter(now.erases - erases, benchmark::Counter::kAvgIterations);
+        state.counters["programmed_bytes"] = benchmark::Counter(now.programmed - programmed, benchmark::Counter::kAvgIterations);
+    }
+};
+
+static volatile uint32_t applied = 0;
+static void apply(HG::Variable, uint32_t value, void*) { applied = applied + value; }
+
+// begin() and load() at boot, with a log of state.range(0) records to replay
+static void BM_ConfigStoreBoot(benchmark::State& state) {
+    static Radio::FlashEmulator flash;
+    memset(flash.data, 0xFF, sizeof(flash.data));
+    Radio::ConfigStore writer(flash);
+    writer.begin();
+    for(uint32_t i = 0; i < (uint32_t) state.range(0); i++) writer.save((HG::Variable) (i % 32), i);
+
+    for(auto _ : state) {
+        Radio::ConfigStore store(flash);
+        benchmark::DoNotOptimize(store.begin());
+        store.load(apply);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ConfigStoreBoot)->ArgName("records")->Arg(0)->Arg(32)->Arg(128)->Arg(FLASH_EMULATOR_SECTOR_SIZE / 8 - 1);
+
+// save() of a changed value, with state.range(0) variables stored: compaction copies all of them
+static void BM_ConfigStoreSave(benchmark::State& state) {
+    static Radio::FlashEmulator flash;
+    memset(flash.data, 0xFF, sizeof(flash.data));
+    Radio::ConfigStore store(flash);
+    store.begin();
+    uint32_t variables = state.range(0);
+    for(uint32_t v = 0; v < variables; v++) store.save((HG::Variable) v, 1);
+    FlashCounts counts(flash);
+    uint32_t compactions = store.compactionCount();
+
+    uint32_t value = 2;
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(store.save((HG::Variable) (value % variables), value));
+        value++;
+    }
+    counts.report(state, flash);
+    state.counters["compactions"] = benchmark::Counter(store.compactionCount() - compactions, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_ConfigStoreSave)->ArgName("variables")->Arg(1)->Arg(32)->Arg(128);
+
+// A save point after TRIGGER_SAVE: saveConfig() over 32 registered variables of which one changed
+static void BM_RobotSaveConfig(benchmark::State& state) {
+    static Radio::FlashEmulator flash;
+    static Radio::ConfigStore store(flash);
+    static CustomRF24_Robot robot;
+    static uint32_t values[32] = {};
+    memset(flash.data, 0xFF, sizeof(flash.data));
+    store.begin();
+    robot.init(1, 100);
+    for(uint8_t i = 0; i < 32; i++) robot.registerVariable(&values[i], (HG::Variable) i, Radio::Access::READWRITE);
+    robot.attachConfigStore(&store);
+    robot.saveConfig();
+
+    FlashCounts counts(flash);
+    uint32_t i = 0;
+    for(auto _ : state) {
+        values[i % 32]++;
+        benchmark::DoNotOptimize(robot.saveConfig());
+        i++;
+    }
+    counts.report(state, flash);
+}
+BENCHMARK(BM_RobotSaveConfig);
@@ -0,0 +1,77 @@
+#include <benchmark/benchmark.h>
+#include "profiler.h"
+
+// On the host cycles() is micros(), so a section costs two clock reads instead of two DWT reads
+
+static volatile uint32_t work = 0;
+
+// The loop body the sections are compared against
+static void BM_ProfilerNone(benchmark::State& state) {
+    for(auto _ : state) {
+        work = work + 1;
+    }
+}
+BENCHMARK(BM_ProfilerNone);
+
+static void BM_ProfilerScope(benchmark::State& state) {
+    Profiler::LoopProfiler profiler;
+    uint8_t section = profiler.addSection("radio");
+    for(auto _ : state) {
+        Profiler::Scope s{profiler, section};
+        work = work + 1;
+    }
+}
+BENCHMARK(BM_ProfilerScope);
+
+// A loop with 7 sections and endLoop(), as attached to the robot
+static void BM_ProfilerLoop(benchmark::State& state) {
+    Profiler::LoopProfiler profiler;
+    static const char* NAMES[] = {"radio", "can", "imu", "control", "serial", "log", "trace"};
+    for(const char* name : NAMES) profiler.addSection(name);
+    for(auto _ : state) {
+        for(uint8_t section = 1; section < profiler.sectionCount(); section++) {
+            Profiler::Scope s{profiler, section};
+            work = work + 1;
+        }
+        profiler.endLoop();
+    }
+}
+BENCHMARK(BM_ProfilerLoop);
+
+static void BM_HistogramAdd(benchmark::State& state) {
+    Profiler::Histogram h;
+    uint32_t ticks = 0;
+    for(auto _ : state) {
+        h.add(ticks);
+        ticks = (ticks * 1103515245 + 12345) & 0x3FFF;     // Spread over all buckets
+    }
+    benchmark::DoNotOptimize(h.size());
+}
+BENCHMARK(BM_HistogramAdd);
+
+// summary() walks the buckets once per percentile
+static void BM_HistogramSummary(benchmark::State& state) {
+    Profiler::Histogram h;
+    uint32_t ticks = 0;
+    for(uint32_t i = 0; i < 10000; i++) {
+        h.add(ticks);
+        ticks = (ticks * 1103515245 + 12345) & 0x3FFF;
+    }
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(h.summary());
+    }
+}
+BENCHMARK(BM_HistogramSummary);
+
+// What sendProfile() does per section
+static void BM_ProfilerFill(benchmark::State& state) {
+    Profiler::LoopProfiler profiler;
+    uint8_t section = profiler.addSection("radio");
+    for(uint32_t i = 0; i < 1000; i++) profiler.record(section, i);
+    Radio::LoopProfile p;
+    for(auto _ : state) {
+        profiler.fill(p, section);
+        benchmark::DoNotOptimize(p);
+    }
+}
+BENCHMARK(BM_ProfilerFill);
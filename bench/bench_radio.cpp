@@ -0,0 +1,134 @@
+#include <benchmark/benchmark.h>
+#include "radio/radio.h"
+
+// ---------------MESSAGES-------------- //
+
+template<typename T>
+static void BM_MessageConstruct(benchmark::State& state) {
+    T payload = {};
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(payload);
+        Radio::Message msg{payload};
+        benchmark::DoNotOptimize(msg);
+    }
+}
+BENCHMARK_TEMPLATE(BM_MessageConstruct, Radio::Command);
+BENCHMARK_TEMPLATE(BM_MessageConstruct, Radio::TrajectoryCommand);
+BENCHMARK_TEMPLATE(BM_MessageConstruct, Radio::Capabilities);
+BENCHMARK_TEMPLATE(BM_MessageConstruct, Radio::MultiConfigMessage);
+BENCHMARK_TEMPLATE(BM_MessageConstruct, Radio::PrimaryStatusHF);
+BENCHMARK_TEMPLATE(BM_MessageConstruct, Radio::PrimaryStatusLF);
+BENCHMARK_TEMPLATE(BM_MessageConstruct, Radio::ImuReadings);
+BENCHMARK_TEMPLATE(BM_MessageConstruct, Radio::OdometryReading);
+BENCHMARK_TEMPLATE(BM_MessageConstruct, Radio::OverrideOdometry);
+BENCHMARK_TEMPLATE(BM_MessageConstruct, Radio::SerialMessage);
+BENCHMARK_TEMPLATE(BM_MessageConstruct, Radio::ShellMessage);
+BENCHMARK_TEMPLATE(BM_MessageConstruct, Radio::LoopProfile);
+BENCHMARK_TEMPLATE(BM_MessageConstruct, Radio::TraceRecord);
+
+static void BM_PipeMapping(benchmark::State& state) {
+    uint8_t radios = state.range(0);
+    for(auto _ : state) {
+        for(Radio::SSL_ID robot = 0; robot < 16; robot++) {
+            benchmark::DoNotOptimize(robot);
+            uint8_t pipe = Radio::getPipe(robot, radios);
+            uint8_t radio = Radio::getRadioID(robot, radios);
+            benchmark::DoNotOptimize(Radio::getRobotID(pipe, radio, radios));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 16);
+}
+BENCHMARK(BM_PipeMapping)->Arg(1)->Arg(4);
+
+
+// ---------------ROBOT----------------- //
+
+static volatile uint32_t commands_handled = 0;
+static void onCommand(Radio::Command) { commands_handled = commands_handled + 1; }
+
+// run() with a message waiting: receiveAndCallback, dispatch and writing the ack payload
+static void robotRun(benchmark::State& state, CustomRF24_Robot& robot, const Radio::Message& msg) {
+    robot.stubReceive(&msg, sizeof(msg));
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(robot.run());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_RobotDispatch(benchmark::State& state) {
+    static CustomRF24_Robot robot;
+    robot.init(1, 100);
+    robot.registerCallback<Radio::Command>(onCommand);
+    Radio::Message msgs[] = {
+        Radio::Message{Radio::Command{}},
+        Radio::Message{Radio::TrajectoryCommand{}},
+        Radio::Message{Radio::Capabilities{}},
+        Radio::Message::NOOP(),
+    };
+    static const char* NAMES[] = {"Command", "TrajectoryCommand", "Capabilities", "NoOp"};
+    robotRun(state, robot, msgs[state.range(0)]);
+    state.SetLabel(NAMES[state.range(0)]);
+}
+BENCHMARK(BM_RobotDispatch)->ArgName("type")->DenseRange(0, 3);
+
+template<typename T>
+struct ConfigVariables {
+    T values[5] = {};
+    static constexpr HG::Variable VARS[5] = {
+        HG::Variable::THRESHOLD_BREAKBEAM, HG::Variable::THRESHOLD_BATTERY_LOW, HG::Variable::THRESHOLD_BATTERY_CRITICAL,
+        HG::Variable::BB_EXTREMA_COUNT, HG::Variable::BB_EXPECTED_GAP,
+    };
+
+    void registerAll(CustomRF24_Robot& robot) {
+        for(uint8_t i = 0; i < 5; i++) robot.registerVariable(&values[i], VARS[i], Radio::Access::READWRITE);
+    }
+};
+
+// handleMultiConfigMessage for 5 variables of width sizeof(T)
+template<typename T>
+static void BM_MultiConfig(benchmark::State& state) {
+    static CustomRF24_Robot robot;
+    static ConfigVariables<T> variables;
+    robot.init(1, 100);
+    variables.registerAll(robot);
+
+    Radio::MultiConfigMessage mcm = {};
+    mcm.operation = (HG::ConfigOperation) state.range(0);
+    for(uint8_t i = 0; i < 5; i++) {
+        mcm.vars[i] = ConfigVariables<T>::VARS[i];
+        mcm.values[i] = i;
+    }
+    robotRun(state, robot, Radio::Message{mcm});
+    state.SetLabel(mcm.operation == HG::ConfigOperation::READ ? "READ" : mcm.operation == HG::ConfigOperation::WRITE ? "WRITE" : "SET_DEFAULT");
+}
+#define CONFIG_OPERATIONS ArgName("op")->Arg((int) HG::ConfigOperation::READ)->Arg((int) HG::ConfigOperation::WRITE)->Arg((int) HG::ConfigOperation::SET_DEFAULT)
+BENCHMARK_TEMPLATE(BM_MultiConfig, uint8_t)->CONFIG_OPERATIONS;
+BENCHMARK_TEMPLATE(BM_MultiConfig, uint16_t)->CONFIG_OPERATIONS;
+BENCHMARK_TEMPLATE(BM_MultiConfig, uint32_t)->CONFIG_OPERATIONS;
+
+// WRITE of variables registered with metadata, so their values are range checked
+static void BM_MultiConfigChecked(benchmark::State& state) {
+    static CustomRF24_Robot robot;
+    static float gains[5];
+    robot.init(1, 100);
+    robot.registerVariable<HG::Variable::SAS_Kp_yaw>(&gains[0], Radio::Access::READWRITE);
+    robot.registerVariable<HG::Variable::SAS_Kd_yaw>(&gains[1], Radio::Access::READWRITE);
+    robot.registerVariable<HG::Variable::SAS_max_yaw_speed>(&gains[2], Radio::Access::READWRITE);
+    robot.registerVariable<HG::Variable::SAS_max_yaw_accel>(&gains[3], Radio::Access::READWRITE);
+    robot.registerVariable<HG::Variable::SAS_max_lin_speed>(&gains[4], Radio::Access::READWRITE);
+
+    Radio::MultiConfigMessage mcm = {};
+    mcm.operation = HG::ConfigOperation::WRITE;
+    mcm.type = HG::VariableType::F32;
+    mcm.vars[0] = HG::Variable::SAS_Kp_yaw;
+    mcm.vars[1] = HG::Variable::SAS_Kd_yaw;
+    mcm.vars[2] = HG::Variable::SAS_max_yaw_speed;
+    mcm.vars[3] = HG::Variable::SAS_max_yaw_accel;
+    mcm.vars[4] = HG::Variable::SAS_max_lin_speed;
+    for(uint8_t i = 0; i < 5; i++) {
+        float v = i % 2 == 0 ? 1.5f : -1.0f;    // Half of them are clamped
+        memcpy(&mcm.values[i], &v, sizeof(v));
+    }
+    robotRun(state, robot, Radio::Message{mcm});
+}
+BENCHMARK(BM_MultiConfigChecked);
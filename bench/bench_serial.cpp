@@ -0,0 +1,231 @@
+#include <benchmark/benchmark.h>
+#include <stdlib.h>
+#include <new>
+#include <vector>
+#include <algorithm>
+#include "serial/serial_interface.h"
+#include "baseline/serial_interface_map.h"
+
+static float gain = 0;
+static int mode = 0;
+static volatile float target_sum = 0;
+static void setTarget(float x, float y, int id) { target_sum = target_sum + x + y + id; }
+static void setSpeed(float v) { target_sum = target_sum + v; }
+
+// Input that repeats the same text forever, output is discarded
+class RepeatStream : public Stream {
+    public:
+        RepeatStream(const char* text) : text{text}, len{strlen(text)} { }
+        int available() override { return 1; }
+        int read() override { char c = text[pos]; pos = (pos + 1) % len; return c; }
+        int peek() override { return text[pos]; }
+        size_t write(uint8_t) override { return 1; }
+        size_t write(const uint8_t*, size_t size) override { return size; }
+        int availableForWrite() override { return 1024; }
+
+    private:
+        const char* text;
+        size_t len;
+        size_t pos = 0;
+};
+
+static void addCommands(SerialInterface& si) {
+    si.initFuns();
+    si.add('p', &gain, "Gain");
+    si.add('m', &mode, "Mode");
+    si.add('t', setTarget, "Target x y id");
+    si.add('s', setSpeed, "Speed");
+}
+
+// The same commands on the std::map/String interface from before the direct-indexed table,
+// which had no typed commands, so 't' parses its own arguments like firmware did then
+static void setTargetText(char* c) {
+    char* end;
+    float x = strtof(c, &end);
+    float y = strtof(end + 1, &end);
+    setTarget(x, y, atoi(end + 1));
+}
+
+static void addCommands(MapSerialInterface& si) {
+    si.initFuns();
+    si.add('p', &gain, "Gain");
+    si.add('m', &mode, "Mode");
+    si.add('t', setTargetText, "Target x y id");
+    si.add('s', setSpeed, "Speed");
+}
+
+// Counts what is allocated with new, for the RAM of an interface. The host std::string keeps
+// short texts inline, so this undercounts the String help texts on the robot
+static size_t heap_bytes = 0;
+static size_t heap_allocations = 0;
+__attribute__((noinline)) void* operator new(size_t size) {
+    heap_bytes += size;
+    heap_allocations++;
+    if(void* p = malloc(size)) return p;
+    throw std::bad_alloc();
+}
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { free(p); }
+
+// Construction and add() of the commands above: the size of the object and what it allocated
+template<typename Interface>
+static void BM_SerialTable(benchmark::State& state) {
+    alignas(Interface) static uint8_t storage[sizeof(Interface)];
+    size_t bytes = 0, allocations = 0;
+    for(auto _ : state) {
+        size_t heap = heap_bytes, count = heap_allocations;
+        Interface* si = new (storage) Interface(&Serial);
+        addCommands(*si);
+        bytes = heap_bytes - heap;
+        allocations = heap_allocations - count;
+        benchmark::DoNotOptimize(si);
+        si->~Interface();
+    }
+    state.counters["object_bytes"] = sizeof(Interface);
+    state.counters["heap_bytes"] = bytes;
+    state.counters["allocations"] = allocations;
+}
+BENCHMARK_TEMPLATE(BM_SerialTable, SerialInterface);
+BENCHMARK_TEMPLATE(BM_SerialTable, MapSerialInterface);
+
+static const char* SERIAL_LINES[] = {"p1.25", "p?", "m3", "t1.5,-2.25 7", "s-0.5e-1", "x"};
+
+// run() on a complete line: lookup, number parsing and the call
+template<typename Interface>
+static void BM_SerialRunLine(benchmark::State& state) {
+    const char* line = SERIAL_LINES[state.range(0)];
+    Interface si(&Serial);
+    addCommands(si);
+    char buffer[SERIAL_INTERFACE_LINE_LENGTH];
+    for(auto _ : state) {
+        strcpy(buffer, line);
+        si.run(buffer);
+    }
+    state.SetLabel(line);
+}
+BENCHMARK_TEMPLATE(BM_SerialRunLine, SerialInterface)->ArgName("line")->DenseRange(0, 5);
+BENCHMARK_TEMPLATE(BM_SerialRunLine, MapSerialInterface)->ArgName("line")->DenseRange(0, 5);
+
+// run() reading from the port, a line per iteration
+static void BM_SerialRunStream(benchmark::State& state) {
+    RepeatStream port("t1.5,-2.25 7\n");
+    SerialInterface si(&port);
+    addCommands(si);
+    for(auto _ : state) {
+        si.run(UINT32_MAX, 13);     // One line
+    }
+    state.SetBytesProcessed(state.iterations() * 13);
+}
+BENCHMARK(BM_SerialRunStream);
+
+// Port that sends at a baud rate through a 16 byte FIFO and waits for room, like HardwareSerial
+class UartPort : public Stream {
+    public:
+        UartPort(uint32_t baud) : byte_us{10e6f / baud} { }
+        void receive(const char* line) { input = line; }
+        bool busy() { return queued() > 0; }
+
+        int available() override { return *input != 0; }
+        int read() override { return *input ? *input++ : -1; }
+        int peek() override { return *input ? *input : -1; }
+        int availableForWrite() override { return FIFO - queued(); }
+        size_t write(uint8_t c) override {
+            while(queued() >= FIFO) { }
+            float now = micros();
+            done_us = (done_us > now ? done_us : now) + byte_us;
+            return 1;
+        }
+        size_t write(const uint8_t* buffer, size_t size) override {
+            for(size_t i = 0; i < size; i++) write(buffer[i]);
+            return size;
+        }
+
+    private:
+        static constexpr int FIFO = 16;
+        int queued() { float left = done_us - micros(); return left > 0 ? (int) (left / byte_us) + 1 : 0; }
+
+        const float byte_us;
+        float done_us = 0;
+        const char* input = "";
+};
+
+static void nothing(char*) { }
+
+// Every slot taken with a long help text, and a subcommand interface
+static void addHelpCommands(SerialInterface& si, SerialInterface& sub) {
+    si.initFuns();
+    for(char c = 'A'; c <= 'R'; c++) si.add(c, nothing, "Command with a help text as long as the real ones");
+    si.add('z', &sub, "Subcommands");
+    sub.initFuns();
+    for(char c = 'a'; c <= 't'; c++) sub.add(c, nothing, "Subcommand with a help text as long as the real ones");
+}
+
+// Help on a slow port, with run() called from a 10 kHz loop: a blocking run() prints all of it
+// in one call, a budgeted run() with an output buffer spreads it over calls. max_run_us is the
+// longest the loop was held up (on a shared host also by the scheduler), p99_run_us excludes that
+template<bool BUDGETED>
+static void BM_SerialHelp(benchmark::State& state) {
+    UartPort port(state.range(0));
+    static OutputBuffer buffer;
+    SerialInterface si(&port), sub(&port, 'z');
+    addHelpCommands(si, sub);
+    if(BUDGETED) si.setOutputBuffer(&buffer);
+    std::vector<uint32_t> run_us;
+    for(auto _ : state) {
+        port.receive("?\n");
+        uint32_t next = micros();
+        do {
+            while((int32_t) (micros() - next) < 0) { }
+            next += 100;
+            uint32_t start = micros();
+            if(BUDGETED) si.run(50, 64);
+            else si.run();
+            run_us.push_back(micros() - start);
+        } while(port.busy() || buffer.used() > 0);
+    }
+    std::sort(run_us.begin(), run_us.end());
+    state.counters["max_run_us"] = run_us.back();
+    state.counters["p99_run_us"] = run_us[run_us.size() * 99 / 100];
+    state.counters["runs"] = benchmark::Counter(run_us.size(), benchmark::Counter::kAvgIterations);
+    state.counters["dropped"] = buffer.droppedCount();
+}
+BENCHMARK_TEMPLATE(BM_SerialHelp, false)->ArgName("baud")->Arg(115200)->Arg(921600)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_SerialHelp, true)->ArgName("baud")->Arg(115200)->Arg(921600)->Unit(benchmark::kMillisecond);
+
+static const char* PARSE_NUMBERS[] = {"1", "-12.5", "3.14159265", ".5e-3", "1e2147483647"};
+
+static void BM_ParseFloat(benchmark::State& state) {
+    const char* number = PARSE_NUMBERS[state.range(0)];
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(number);
+        const char* p = number;
+        float f = 0;
+        benchmark::DoNotOptimize(NumberParse::parse(p, f));
+        benchmark::DoNotOptimize(f);
+    }
+    state.SetLabel(number);
+}
+BENCHMARK(BM_ParseFloat)->ArgName("number")->DenseRange(0, 4);
+
+// Baselines: the libc parsers SerialInterface used before
+static void BM_ParseFloatAtof(benchmark::State& state) {
+    const char* number = PARSE_NUMBERS[state.range(0)];
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(number);
+        benchmark::DoNotOptimize((float) atof(number));
+    }
+    state.SetLabel(number);
+}
+BENCHMARK(BM_ParseFloatAtof)->ArgName("number")->DenseRange(0, 4);
+
+static void BM_ParseFloatStrtof(benchmark::State& state) {
+    const char* number = PARSE_NUMBERS[state.range(0)];
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(number);
+        char* end;
+        benchmark::DoNotOptimize(strtof(number, &end));
+        benchmark::DoNotOptimize(end);
+    }
+    state.SetLabel(number);
+}
+BENCHMARK(BM_ParseFloatStrtof)->ArgName("number")->DenseRange(0, 4);
@@ -0,0 +1,132 @@
+#include <benchmark/benchmark.h>
+#include "can/can_codec.h"
+#include "can/virtual_can.h"
+
+using namespace CAN;
+
+// The wheel control loop of CAN::BusLoad::Example on the virtual bus: the primary broadcasts a
+// COMMAND every period, the 4 drivers answer it with EncoderFeedback and send a status every 100 ms.
+// A cycle is complete when the feedback of all drivers is in, late if that is after the next command.
+
+static constexpr uint8_t NUM_DRIVERS = 4;
+static constexpr DEVICE_ID DRIVERS[NUM_DRIVERS] = {DEVICE_ID::DRIVER_0, DEVICE_ID::DRIVER_1, DEVICE_ID::DRIVER_2, DEVICE_ID::DRIVER_3};
+
+class Primary : public Virtual::Node {
+    public:
+        Primary(uint32_t period_us) : period_ns{(uint64_t) period_us * 1000} { }
+
+        uint64_t tick(Virtual::Bus&, uint64_t now_ns) override {
+            if(cycles > 0 && received != (1 << NUM_DRIVERS) - 1) late++;
+            STM32::CAN::msg_t frame = {};
+            encode(frame, DEVICE_ID::BROADCAST, COMMAND{{100, 100, 100, 100}});
+            if(!send(frame, now_ns)) late++;
+            cycle_start_ns = now_ns;
+            received = 0;
+            cycles++;
+            return now_ns + period_ns;
+        }
+
+        void receive(Virtual::Bus&, const STM32::CAN::msg_t& frame, uint64_t now_ns) override {
+            if(getMessageId(frame.id) != MESSAGE_ID::ENCODER) return;
+            EncoderFeedback feedback;
+            if(!decode(frame, feedback)) return;
+            for(uint8_t d = 0; d < NUM_DRIVERS; d++) {
+                if(feedback.txId == DRIVERS[d]) received |= 1 << d;
+            }
+            if(received != (1 << NUM_DRIVERS) - 1) return;
+            uint64_t latency = now_ns - cycle_start_ns;
+            complete++;
+            total_latency_ns += latency;
+            if(latency > max_latency_ns) max_latency_ns = latency;
+        }
+
+        uint32_t cycles = 0;
+        uint32_t complete = 0;
+        uint32_t late = 0;
+        uint64_t total_latency_ns = 0;
+        uint64_t max_latency_ns = 0;
+
+    private:
+        uint64_t period_ns;
+        uint64_t cycle_start_ns = 0;
+        uint8_t received = 0;
+};
+
+class Driver : public Virtual::Node {
+    public:
+        Driver(DEVICE_ID id, uint8_t index) : id{id}, status_offset_ns{(uint64_t) index * 25000000} { }
+
+        // Status, spread over the 100 ms
+        uint64_t tick(Virtual::Bus&, uint64_t now_ns) override {
+            if(now_ns < status_offset_ns) return status_offset_ns;
+            STM32::CAN::msg_t frame = {};
+            encode(frame, id, MotorStatusMessage{id, {}});
+            send(frame, now_ns);
+            return now_ns + 100000000;
+        }
+
+        // Answer a command with the encoder speed at once
+        void receive(Virtual::Bus&, const STM32::CAN::msg_t& frame, uint64_t now_ns) override {
+            if(getMessageId(frame.id) != MESSAGE_ID::SET_COMMAND) return;
+            STM32::CAN::msg_t reply = {};
+            encode(reply, id, EncoderFeedback{id, 1.0f});
+            send(reply, now_ns);
+        }
+
+    private:
+        DEVICE_ID id;
+        uint64_t status_offset_ns;
+};
+
+struct ControlLoop {
+    Virtual::Bus bus;
+    Primary primary;
+    Driver drivers[NUM_DRIVERS] = {{DRIVERS[0], 0}, {DRIVERS[1], 1}, {DRIVERS[2], 2}, {DRIVERS[3], 3}};
+
+    ControlLoop(uint32_t period_us, STM32::CAN::Bitrate bitrate, float error_rate) : bus{bitrate}, primary{period_us} {
+        bus.setErrorRate(error_rate);
+        bus.attach(primary);
+        for(Driver& d : drivers) bus.attach(d);
+    }
+};
+
+// One simulated second per iteration, period [us] and errors per 1000 frames as arguments
+static void BM_CanControlLoop(benchmark::State& state) {
+    uint32_t period_us = state.range(0);
+    float error_rate = state.range(1) / 1000.0f;
+    Primary result(period_us);
+    float load = 0;
+    for(auto _ : state) {
+        ControlLoop loop(period_us, STM32::CAN::CAN_1000kbps, error_rate);
+        loop.bus.run(1000000000ull);
+        result.cycles += loop.primary.cycles;
+        result.complete += loop.primary.complete;
+        result.late += loop.primary.late;
+        result.total_latency_ns += loop.primary.total_latency_ns;
+        if(loop.primary.max_latency_ns > result.max_latency_ns) result.max_latency_ns = loop.primary.max_latency_ns;
+        load = loop.bus.load();
+    }
+    state.counters["rate_hz"] = 1e6 / period_us;
+    state.counters["late"] = (double) result.late / result.cycles;
+    state.counters["latency_avg_us"] = result.complete == 0 ? 0 : result.total_latency_ns / 1000.0 / result.complete;
+    state.counters["latency_max_us"] = result.max_latency_ns / 1000.0;
+    state.counters["bus_load"] = load;
+}
+BENCHMARK(BM_CanControlLoop)->ArgNames({"period_us", "errors_per_1000"})
+    ->Args({2000, 0})->Args({1250, 0})->Args({1000, 0})->Args({800, 0})->Args({700, 0})->Args({1000, 10})
+    ->Unit(benchmark::kMillisecond);
+
+// Shortest period, in steps of 10 us, at which no cycle is late during a simulated second
+static void BM_CanControlLoopMaxRate(benchmark::State& state) {
+    uint32_t period_us = 0;
+    for(auto _ : state) {
+        for(period_us = 2000; period_us > 100; period_us -= 10) {
+            ControlLoop loop(period_us - 10, STM32::CAN::CAN_1000kbps, 0);
+            loop.bus.run(1000000000ull);
+            if(loop.primary.late > 0) break;
+        }
+    }
+    state.counters["period_us"] = period_us;
+    state.counters["rate_hz"] = 1e6 / period_us;
+}
+BENCHMARK(BM_CanControlLoopMaxRate)->Unit(benchmark::kMillisecond)->Iterations(1);
@@ -0,0 +1,82 @@
+// Delft Mercurians
+// 2026-10-19
+
+// Just enough of the Arduino core to build the protocols on a PC, for the benchmarks
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string>
+
+enum { PA0, PA1, PA3, PA4, PA5, PA6, PA7, PB0, PB1, PB8, PB10, PB11, PB12, PB13, PB14, PB15 };
+
+uint32_t micros();
+uint32_t millis();
+
+class String : public std::string {
+    public:
+        String(const char* c = "") : std::string(c) { }
+        String(const std::string& s) : std::string(s) { }
+};
+
+class Print {
+    public:
+        virtual ~Print() = default;
+        virtual size_t write(uint8_t c) = 0;
+        virtual size_t write(const uint8_t* buffer, size_t size) {
+            size_t n = 0;
+            while(size--) n += write(*buffer++);
+            return n;
+        }
+        virtual int availableForWrite() { return 0; }
+        virtual void flush() { }
+
+        size_t write(const char* s) { return write((const uint8_t*) s, strlen(s)); }
+        size_t write(const char* s, size_t size) { return write((const uint8_t*) s, size); }
+
+        size_t print(const char* s) { return write(s); }
+        size_t print(char c) { return write((uint8_t) c); }
+        size_t print(const String& s) { return write(s.c_str()); }
+        size_t print(int v) { return printf("%d", v); }
+        size_t print(unsigned v) { return printf("%u", v); }
+        size_t print(float v, int digits = 2) { return printf("%.*f", digits, v); }
+        size_t println(const char* s = "") { return print(s) + write("\r\n"); }
+        size_t println(const String& s) { return print(s) + write("\r\n"); }
+        size_t println(int v) { return print(v) + write("\r\n"); }
+        size_t println(unsigned v) { return print(v) + write("\r\n"); }
+        size_t println(float v, int digits = 2) { return print(v, digits) + write("\r\n"); }
+
+        size_t printf(const char* format, ...) {
+            char buffer[256];
+            va_list args;
+            va_start(args, format);
+            int n = vsnprintf(buffer, sizeof(buffer), format, args);
+            va_end(args);
+            if(n < 0) return 0;
+            return write((const uint8_t*) buffer, (size_t) n < sizeof(buffer) ? n : sizeof(buffer) - 1);
+        }
+};
+
+class Stream : public Print {
+    public:
+        virtual int available() = 0;
+        virtual int read() = 0;
+        virtual int peek() = 0;
+};
+
+// Discards output, has no input
+class HardwareSerial : public Stream {
+    public:
+        size_t write(uint8_t) override { return 1; }
+        size_t write(const uint8_t*, size_t size) override { return size; }
+        int availableForWrite() override { return 1024; }
+        int available() override { return 0; }
+        int read() override { return -1; }
+        int peek() override { return -1; }
+};
+
+extern HardwareSerial Serial;
@@ -0,0 +1,58 @@
+// Delft Mercurians
+// 2026-10-19
+
+// RF24 without a radio: writes go nowhere, and stubReceive() sets the payload that is received
+// on every read, so the receive path can be run in a loop
+
+#pragma once
+#include <Arduino.h>
+#include <SPI.h>
+
+typedef int rf24_gpio_pin_t;
+
+typedef enum { RF24_PA_MIN = 0, RF24_PA_LOW, RF24_PA_HIGH, RF24_PA_MAX, RF24_PA_ERROR } rf24_pa_dbm_e;
+
+class RF24 {
+    public:
+        RF24() { }
+        RF24(rf24_gpio_pin_t cepin, rf24_gpio_pin_t cspin) { }
+
+        bool begin(SPIClass* spi) { return true; }
+        bool isChipConnected() { return true; }
+        bool isPVariant() { return true; }
+        void setPALevel(uint8_t level, bool lna_enable = true) { }
+        void setChannel(uint8_t channel) { }
+        void setPayloadSize(uint8_t size) { }
+        void setAutoAck(uint8_t pipe, bool enable) { }
+        void enableDynamicPayloads() { }
+        void enableAckPayload() { }
+        void startListening() { }
+        void stopListening() { }
+        void openWritingPipe(uint64_t address) { }
+        void openReadingPipe(uint8_t number, uint64_t address) { }
+        uint8_t flush_tx() { return 0; }
+        bool isFifo(bool about_tx, bool check_empty) { return true; }
+
+        bool write(const void* buf, uint8_t len, const bool multicast = false) { return true; }
+        void startFastWrite(const void* buf, uint8_t len, const bool multicast, bool start_tx = true) { }
+        bool writeAckPayload(uint8_t pipe, const void* buf, uint8_t len) { return true; }
+
+        bool available(uint8_t* pipe_num = nullptr) {
+            if(pipe_num != nullptr) *pipe_num = stub_pipe;
+            return stub_len > 0;
+        }
+        uint8_t getDynamicPayloadSize() { return stub_len; }
+        void read(void* buf, uint8_t len) { memcpy(buf, stub_payload, len < stub_len ? len : stub_len); }
+
+        // Payload every following read() returns, len 0 for nothing
+        void stubReceive(const void* buf, uint8_t len, uint8_t pipe = 1) {
+            stub_len = len > sizeof(stub_payload) ? sizeof(stub_payload) : len;
+            memcpy(stub_payload, buf, stub_len);
+            stub_pipe = pipe;
+        }
+
+    private:
+        uint8_t stub_payload[32] = {};
+        uint8_t stub_len = 0;
+        uint8_t stub_pipe = 1;
+};
@@ -0,0 +1,10 @@
+// Delft Mercurians
+// 2026-10-19
+
+#pragma once
+#include <Arduino.h>
+
+class SPIClass {
+    public:
+        SPIClass(int mosi, int miso, int sclk) { }
+};
@@ -0,0 +1,14 @@
+#include "Arduino.h"
+#include <chrono>
+
+HardwareSerial Serial;
+
+static const auto start = std::chrono::steady_clock::now();
+
+uint32_t micros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+uint32_t millis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
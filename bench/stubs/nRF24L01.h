@@ -0,0 +1,4 @@
+// Delft Mercurians
+// 2026-10-19
+
+#pragma once
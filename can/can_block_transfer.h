@@ -0,0 +1,323 @@
+// Delft Mercurians
+// 2026-10-19
+
+// Block transfers of CAN variables (see BLOCK_* in protocols_can.h)
+//
+// BlockSender runs on the primary, one per motor driver that is being configured.
+// BlockReceiver runs on the motor drivers next to the single variable access handling.
+
+#pragma once
+#include "can_codec.h"
+
+namespace CAN {
+
+typedef bool (*BlockSend)(const STM32::CAN::msg_t& frame);  // false if the frame could not be queued
+
+// Motor driver side of a block transfer
+class BlockReceiver {
+    public:
+        typedef bool (*Write)(VARIABLE variable, CAN_VARIABLE_TYPE value);   // false if not writeable
+        typedef bool (*Read)(VARIABLE variable, CAN_VARIABLE_TYPE& value);   // false if not readable
+
+        BlockReceiver(DEVICE_ID self, Write write, Read read, BlockSend send, DEVICE_ID reply_to = DEVICE_ID::PRIMARY)
+            : self{self}, reply_to{reply_to}, fun_write{write}, fun_read{read}, fun_send{send}
+        { }
+
+        // Returns true if the frame was part of a block transfer
+        bool handle(const STM32::CAN::msg_t& frame) {
+            switch(getMessageId(frame.id)) {
+                case MESSAGE_ID::BLOCK_WRITE: {
+                    BlockStart start;
+                    if(!decode(frame, start)) return true;
+                    if(start.count > CAN_BLOCK_MAX_VARIABLES) {
+                        queueAck(start.session, 0, BlockStatus::REJECTED);
+                        return true;
+                    }
+                    writing = true;
+                    session = start.session;
+                    count = start.count;
+                    next_seq = 0;
+                    gap_reported = false;
+                    if(count == 0) finishWrite();
+                    break;
+                }
+                case MESSAGE_ID::BLOCK_DATA: {
+                    BlockData data;
+                    if(!decode(frame, data) || !writing || data.session != session) return true;
+                    if(data.seq != next_seq) {
+                        // Report every gap once, the sender resumes at next_seq
+                        if(data.seq > next_seq && !gap_reported) {
+                            gap_reported = true;
+                            queueAck(session, next_seq, BlockStatus::INCOMPLETE);
+                        }
+                        return true;
+                    }
+                    gap_reported = false;
+                    staged_variables[next_seq] = data.variable;
+                    staged_values[next_seq] = data.value;
+                    next_seq++;
+                    if(next_seq == count) finishWrite();
+                    break;
+                }
+                case MESSAGE_ID::BLOCK_READ: {
+                    BlockStart start;
+                    if(!decode(frame, start)) return true;
+                    reading = true;
+                    read_session = start.session;
+                    read_next = start.first & (uint8_t) VARIABLE::MASK;
+                    uint16_t end = (uint16_t) read_next + start.count;    // Would wrap in 8 bits
+                    read_end = end > (uint16_t) VARIABLE::MASK + 1 ? (uint16_t) VARIABLE::MASK + 1 : end;
+                    read_sent = 0;
+                    break;
+                }
+                default:
+                    return false;
+            }
+            poll();
+            return true;
+        }
+
+        // Send whatever did not fit in the mailboxes before, call from the loop
+        void poll() {
+            if(ack_pending) {
+                if(!send(MESSAGE_ID::BLOCK_ACK, ack)) return;
+                ack_pending = false;
+            }
+            while(reading) {
+                if(read_next >= read_end) {
+                    reading = false;
+                    queueAck(read_session, read_sent, BlockStatus::OK);
+                    return;
+                }
+                CAN_VARIABLE_TYPE value;
+                if(!fun_read((VARIABLE) read_next, value)) {
+                    read_next++;    // Skip variables that can't be read
+                    continue;
+                }
+                BlockData data = {read_session, read_sent, read_next, 0, value};
+                if(!send(MESSAGE_ID::BLOCK_DATA, data)) return;
+                read_sent++;
+                read_next++;
+            }
+        }
+
+    private:
+        DEVICE_ID self;
+        DEVICE_ID reply_to;
+        Write fun_write;
+        Read fun_read;
+        BlockSend fun_send;
+
+        // Write session
+        bool writing = false;
+        bool gap_reported = false;
+        uint8_t session = 0;
+        uint8_t count = 0;
+        uint8_t next_seq = 0;
+        uint8_t staged_variables[CAN_BLOCK_MAX_VARIABLES];
+        CAN_VARIABLE_TYPE staged_values[CAN_BLOCK_MAX_VARIABLES];
+
+        // Read session
+        bool reading = false;
+        uint8_t read_session = 0;
+        uint8_t read_next = 0;
+        uint8_t read_end = 0;
+        uint8_t read_sent = 0;
+
+        bool ack_pending = false;
+        BlockAck ack;
+
+        // Apply all staged values at once, so a controller never runs with half a parameter set
+        void finishWrite() {
+            writing = false;
+            BlockStatus status = BlockStatus::OK;
+            for(uint8_t i = 0; i < count; i++) {
+                if(!fun_write((VARIABLE) staged_variables[i], staged_values[i])) status = BlockStatus::REJECTED;
+            }
+            queueAck(session, count, status);
+        }
+
+        void queueAck(uint8_t ack_session, uint8_t received, BlockStatus status) {
+            ack = BlockAck{self, ack_session, received, status, {0, 0, 0, 0}};
+            ack_pending = true;
+        }
+
+        template<typename T>
+        bool send(MESSAGE_ID message, const T& payload) {
+            STM32::CAN::msg_t frame;
+            encode(frame, reply_to, message, payload);
+            return fun_send(frame);
+        }
+};
+
+
+// Primary side of a block transfer with one motor driver
+class BlockSender {
+    public:
+        enum class State : uint8_t {
+            IDLE,
+            WRITING,
+            READING,
+            DONE,       // Last transfer completed
+            FAILED,     // Last transfer was rejected or ran out of retries, see status()
+        };
+
+        struct Value {
+            VARIABLE variable;
+            CAN_VARIABLE_TYPE value;
+        };
+
+        typedef void (*OnValue)(DEVICE_ID device, VARIABLE variable, CAN_VARIABLE_TYPE value);
+
+        BlockSender(BlockSend send, uint32_t timeout_ms = 20, uint8_t retries = 3)
+            : fun_send{send}, timeout_ms{timeout_ms}, max_retries{retries}
+        { }
+
+        // Write values (kept by the caller until done) to one device
+        bool write(DEVICE_ID device, const Value* values, uint8_t count, uint32_t now_ms) {
+            if(busy() || count > CAN_BLOCK_MAX_VARIABLES) return false;
+            this->values = values;
+            this->count = count;
+            begin(device, State::WRITING, now_ms);
+            return true;
+        }
+
+        // Read a range of variables from one device, on_value is called for every readable one
+        bool read(DEVICE_ID device, VARIABLE first, uint8_t count, OnValue on_value, uint32_t now_ms) {
+            if(busy()) return false;
+            this->first = (uint8_t) first;
+            this->count = count;
+            this->on_value = on_value;
+            begin(device, State::READING, now_ms);
+            return true;
+        }
+
+        // Returns true if the frame belonged to this transfer
+        bool handle(const STM32::CAN::msg_t& frame, uint32_t now_ms) {
+            if(!busy()) return false;
+            switch(getMessageId(frame.id)) {
+                case MESSAGE_ID::BLOCK_DATA: {
+                    BlockData data;
+                    if(state_ != State::READING || !decode(frame, data) || data.session != session) return false;
+                    last_activity_ms = now_ms;
+                    if(data.seq != received) {
+                        read_gap = true;    // Retried once the stream ends
+                        return true;
+                    }
+                    received++;
+                    if(on_value != nullptr) on_value(device, (VARIABLE) data.variable, data.value);
+                    return true;
+                }
+                case MESSAGE_ID::BLOCK_ACK: {
+                    BlockAck ack;
+                    if(!decode(frame, ack) || ack.session != session || ack.txId != device) return false;
+                    last_activity_ms = now_ms;
+                    status_ = ack.status;
+                    switch(ack.status) {
+                        case BlockStatus::OK:
+                            if(state_ == State::READING && (read_gap || ack.received != received)) {
+                                retry(now_ms);
+                            } else {
+                                state_ = State::DONE;
+                            }
+                            break;
+                        case BlockStatus::INCOMPLETE:
+                            if(state_ == State::WRITING && ack.received < next) next = ack.received;
+                            break;
+                        case BlockStatus::REJECTED:
+                        case BlockStatus::BUSY:
+                            state_ = State::FAILED;
+                            break;
+                    }
+                    return true;
+                }
+                default:
+                    return false;
+            }
+        }
+
+        // Send frames and handle timeouts, call from the loop
+        void poll(uint32_t now_ms) {
+            if(!busy()) return;
+            if(now_ms - last_activity_ms > timeout_ms) {
+                retry(now_ms);
+                if(!busy()) return;
+            }
+            if(!start_sent) {
+                BlockStart start = {session, count, first, {0, 0, 0, 0, 0}};
+                if(!send(state_ == State::WRITING ? MESSAGE_ID::BLOCK_WRITE : MESSAGE_ID::BLOCK_READ, start)) return;
+                start_sent = true;
+            }
+            while(state_ == State::WRITING && next < count) {
+                BlockData data = {session, next, (uint8_t) values[next].variable, 0, values[next].value};
+                if(!send(MESSAGE_ID::BLOCK_DATA, data)) return;
+                next++;
+                last_activity_ms = now_ms;
+            }
+        }
+
+        bool busy() const { return state_ == State::WRITING || state_ == State::READING; }
+        State state() const { return state_; }
+        BlockStatus status() const { return status_; }
+
+    private:
+        BlockSend fun_send;
+        uint32_t timeout_ms;
+        uint8_t max_retries;
+
+        // Shared by all senders, so replies can be matched without a source address
+        static inline uint8_t next_session = 0;
+
+        State state_ = State::IDLE;
+        BlockStatus status_ = BlockStatus::OK;
+        DEVICE_ID device = DEVICE_ID::BROADCAST;
+        uint8_t session = 0;
+        uint8_t retries = 0;
+        uint32_t last_activity_ms = 0;
+        bool start_sent = false;
+
+        const Value* values = nullptr;
+        uint8_t count = 0;
+        uint8_t next = 0;       // Next data frame to send
+
+        uint8_t first = 0;
+        uint8_t received = 0;   // Read values received in order
+        bool read_gap = false;
+        OnValue on_value = nullptr;
+
+        void begin(DEVICE_ID device, State state, uint32_t now_ms) {
+            this->device = device;
+            state_ = state;
+            status_ = BlockStatus::OK;
+            session = next_session++;
+            retries = 0;
+            restart(now_ms);
+            poll(now_ms);
+        }
+
+        void restart(uint32_t now_ms) {
+            last_activity_ms = now_ms;
+            start_sent = false;
+            next = 0;
+            received = 0;
+            read_gap = false;
+        }
+
+        void retry(uint32_t now_ms) {
+            if(retries++ >= max_retries) {
+                state_ = State::FAILED;
+                status_ = BlockStatus::INCOMPLETE;
+                return;
+            }
+            restart(now_ms);
+        }
+
+        template<typename T>
+        bool send(MESSAGE_ID message, const T& payload) {
+            STM32::CAN::msg_t frame;
+            encode(frame, device, message, payload);
+            return fun_send(frame);
+        }
+};
+
+} // namespace CAN
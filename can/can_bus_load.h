@@ -0,0 +1,200 @@
+// Delft Mercurians
+// 2026-10-19
+
+// CAN bus load model and runtime bus statistics
+//
+// The offline model takes a schedule of periodic messages and gives the bus utilization
+// and worst case response time of every message, using the sufficient schedulability test
+// from Davis et al. (2007), "Controller Area Network (CAN) schedulability analysis:
+// Refuted, revisited and revised". All of it is constexpr, so a schedule can be checked
+// with a static_assert next to where it is defined.
+
+#pragma once
+#include <stddef.h>
+#include "protocols_can.h"
+
+namespace CAN::BusLoad {
+
+// Worst case length of a standard data frame in bits, including bit stuffing and interframe space
+inline constexpr uint32_t frameBits(uint8_t len) {
+    return 55 + 10 * (uint32_t) len;    // 8n + 47 + floor((34 + 8n - 1) / 4)
+}
+
+// Periodic message, lower ID is higher priority
+struct PeriodicMessage {
+    uint16_t id;            // Full 11 bit ID (see makeId)
+    uint8_t len;            // Data bytes
+    uint32_t period_us;     // Period, also the deadline [us]
+    uint32_t jitter_us;     // Queuing jitter [us]
+};
+
+struct Result {
+    uint32_t transmission_us;   // Worst case transmission time [us]
+    uint32_t response_us;       // Worst case response time, from queuing to received [us]
+    bool schedulable;           // Response time is within the period
+};
+
+inline constexpr uint64_t toBits(uint32_t us, uint32_t bitrate) {
+    return ((uint64_t) us * bitrate + 999999) / 1000000;    // Round up
+}
+inline constexpr uint32_t toMicros(uint64_t bits, uint32_t bitrate) {
+    return (uint32_t) ((bits * 1000000 + bitrate - 1) / bitrate);  // Round up
+}
+
+// Fraction of the bus used by the schedule, worst case stuffing
+template<size_t N>
+constexpr float utilization(const PeriodicMessage (&schedule)[N], STM32::CAN::Bitrate bitrate) {
+    float u = 0;
+    for(size_t i = 0; i < N; i++) {
+        u += (float) frameBits(schedule[i].len) * 1e6f / ((float) schedule[i].period_us * STM32::CAN::SPEED[bitrate]);
+    }
+    return u;
+}
+
+// Worst case response time of message i of the schedule
+template<size_t N>
+constexpr Result analyse(const PeriodicMessage (&schedule)[N], size_t i, STM32::CAN::Bitrate bitrate) {
+    const uint32_t rate = STM32::CAN::SPEED[bitrate];
+    const PeriodicMessage& m = schedule[i];
+    const uint64_t c = frameBits(m.len);
+    const uint64_t deadline = toBits(m.period_us, rate);
+    const uint64_t jitter = toBits(m.jitter_us, rate);
+
+    // Blocking by the longest frame of lower priority, or this one
+    uint64_t w0 = c;
+    for(size_t k = 0; k < N; k++) {
+        if(schedule[k].id > m.id && frameBits(schedule[k].len) > w0) w0 = frameBits(schedule[k].len);
+    }
+
+    // Queuing delay: iterate until it converges or the deadline is missed
+    uint64_t w = w0;
+    while(true) {
+        uint64_t next = w0;
+        for(size_t j = 0; j < N; j++) {
+            if(j == i || schedule[j].id > m.id) continue;    // Equal IDs from other nodes interfere too
+            uint64_t t = toBits(schedule[j].period_us, rate);
+            uint64_t activations = (w + toBits(schedule[j].jitter_us, rate) + 1 + t - 1) / t;
+            next += activations * frameBits(schedule[j].len);
+        }
+        if(next == w || jitter + next + c > deadline) {
+            w = next;
+            break;
+        }
+        w = next;
+    }
+
+    uint64_t r = jitter + w + c;
+    return Result{toMicros(c, rate), toMicros(r, rate), r <= deadline};
+}
+
+// Whether no two messages of the schedule share an ID. Nodes sending the same ID with different
+// data collide instead of arbitrating, so the analysis only holds for unique IDs
+template<size_t N>
+constexpr bool uniqueIds(const PeriodicMessage (&schedule)[N]) {
+    for(size_t i = 0; i < N; i++) {
+        for(size_t j = i + 1; j < N; j++) {
+            if(schedule[i].id == schedule[j].id) return false;
+        }
+    }
+    return true;
+}
+
+// Whether every message of the schedule meets its deadline
+template<size_t N>
+constexpr bool schedulable(const PeriodicMessage (&schedule)[N], STM32::CAN::Bitrate bitrate) {
+    if(!uniqueIds(schedule)) return false;
+    if(utilization(schedule, bitrate) >= 1.0f) return false;
+    for(size_t i = 0; i < N; i++) {
+        if(!analyse(schedule, i, bitrate).schedulable) return false;
+    }
+    return true;
+}
+
+// Example: wheel control loop with a period of PERIOD_US, this is checked at compile time
+// Feedback to the primary carries the sending driver in the device bits, like the txId in its payload
+namespace Example {
+template<uint32_t PERIOD_US>
+constexpr PeriodicMessage CONTROL[] = {
+    {makeId(DEVICE_ID::BROADCAST, MESSAGE_ID::SET_COMMAND), sizeof(COMMAND), PERIOD_US, 50},
+    {makeId(DEVICE_ID::DRIVER_0, MESSAGE_ID::ENCODER), sizeof(EncoderFeedback), PERIOD_US, 50},
+    {makeId(DEVICE_ID::DRIVER_1, MESSAGE_ID::ENCODER), sizeof(EncoderFeedback), PERIOD_US, 50},
+    {makeId(DEVICE_ID::DRIVER_2, MESSAGE_ID::ENCODER), sizeof(EncoderFeedback), PERIOD_US, 50},
+    {makeId(DEVICE_ID::DRIVER_3, MESSAGE_ID::ENCODER), sizeof(EncoderFeedback), PERIOD_US, 50},
+    {makeId(DEVICE_ID::DRIVER_0, MESSAGE_ID::STATUS), sizeof(MotorStatusMessage), 100000, 0},
+    {makeId(DEVICE_ID::DRIVER_1, MESSAGE_ID::STATUS), sizeof(MotorStatusMessage), 100000, 0},
+    {makeId(DEVICE_ID::DRIVER_2, MESSAGE_ID::STATUS), sizeof(MotorStatusMessage), 100000, 0},
+    {makeId(DEVICE_ID::DRIVER_3, MESSAGE_ID::STATUS), sizeof(MotorStatusMessage), 100000, 0},
+};
+inline constexpr auto& CONTROL_1KHZ = CONTROL<1000>;
+inline constexpr auto& CONTROL_800HZ = CONTROL<1250>;
+
+// STATUS (0x?C1) wins arbitration over ENCODER (0x?CB), so in the worst case the encoder frames of
+// DRIVER_2 and DRIVER_3 wait for the status frames of the lower numbered drivers and miss 1 ms
+static_assert(!schedulable(CONTROL_1KHZ, STM32::CAN::CAN_1000kbps));
+static_assert(schedulable(CONTROL_800HZ, STM32::CAN::CAN_1000kbps));
+static_assert(!schedulable(CONTROL_800HZ, STM32::CAN::CAN_500kbps));
+} // namespace Example
+
+} // namespace CAN::BusLoad
+
+
+namespace CAN {
+
+// Runtime bus statistics, count from the CAN interrupts and call update() from the loop
+class BusStatistics {
+    public:
+        // Counters, safe to increment from interrupts
+        volatile uint32_t tx_frames = 0;
+        volatile uint32_t rx_frames = 0;
+        volatile uint32_t tx_bits = 0;      // Worst case bits, see BusLoad::frameBits
+        volatile uint32_t rx_bits = 0;
+        volatile uint32_t bus_off = 0;
+        volatile uint32_t error_passive = 0;
+        volatile uint32_t error_warning = 0;
+        volatile uint32_t mailbox_full = 0; // Frame could not be queued, all mailboxes were busy
+        volatile uint32_t rx_overrun = 0;   // Frame lost, receive FIFO was full
+
+        void countTx(uint8_t len) {
+            tx_frames = tx_frames + 1;
+            tx_bits = tx_bits + BusLoad::frameBits(len);
+        }
+        void countRx(uint8_t len) {
+            rx_frames = rx_frames + 1;
+            rx_bits = rx_bits + BusLoad::frameBits(len);
+        }
+
+        // Recompute rates once per interval, returns true when they were updated
+        bool update(uint32_t now_ms, uint32_t interval_ms = 1000) {
+            uint32_t dt = now_ms - last_update_ms;
+            if(dt < interval_ms) return false;
+            uint32_t tx = tx_frames, rx = rx_frames, bits = tx_bits + rx_bits;
+            tx_per_second = (uint32_t) ((uint64_t) (tx - last_tx_frames) * 1000 / dt);
+            rx_per_second = (uint32_t) ((uint64_t) (rx - last_rx_frames) * 1000 / dt);
+            bits_per_second = (uint32_t) ((uint64_t) (bits - last_bits) * 1000 / dt);
+            last_tx_frames = tx;
+            last_rx_frames = rx;
+            last_bits = bits;
+            last_update_ms = now_ms;
+            return true;
+        }
+
+        uint32_t txPerSecond() const { return tx_per_second; }
+        uint32_t rxPerSecond() const { return rx_per_second; }
+
+        // Upper bound of the bus load seen by this node (0 -> 1)
+        float load(STM32::CAN::Bitrate bitrate) const {
+            return (float) bits_per_second / STM32::CAN::SPEED[bitrate];
+        }
+
+    private:
+        uint32_t last_update_ms = 0;
+        uint32_t last_tx_frames = 0;
+        uint32_t last_rx_frames = 0;
+        uint32_t last_bits = 0;
+
+        uint32_t tx_per_second = 0;
+        uint32_t rx_per_second = 0;
+        uint32_t bits_per_second = 0;
+};
+
+} // namespace CAN
@@ -0,0 +1,146 @@
+// Delft Mercurians
+// 2026-10-19
+
+// Clock synchronisation between the primary and the motor drivers over CAN::MESSAGE_ID::SYNC
+//
+// The primary is the time base. It broadcasts SYNC periodically and timestamps each one when
+// its transmission completes. Every driver timestamps the reception, pairs it with the transmit
+// time carried by the next SYNC, and steers a local model (offset and drift) towards it.
+// The constant reception delay is the same for all drivers, so samples taken on different
+// drivers line up with each other even though it is not compensated.
+
+#pragma once
+#include "can_codec.h"
+#include "../scaling.h"
+
+namespace CAN {
+
+// SYNC sequence numbers skip 0, which EncoderFeedbackTimed uses for an unsynchronised sample
+inline constexpr uint8_t nextSyncSeq(uint8_t seq) { return seq == UINT8_MAX ? 1 : seq + 1; }
+
+// Primary side
+class SyncMaster {
+    public:
+        // Next SYNC frame, flags: CAN_SYNC_FLAG_SAMPLE to request synchronised encoder samples
+        STM32::CAN::msg_t makeSync(uint8_t flags = 0) {
+            SyncMessage sync = {seq, flags, {0, 0}, previous_tx};
+            if(previous_valid) sync.flags |= CAN_SYNC_FLAG_PREVIOUS_VALID;
+            previous_valid = false;
+            pending = true;
+            STM32::CAN::msg_t frame;
+            encode(frame, DEVICE_ID::BROADCAST, sync);
+            return frame;
+        }
+
+        // Call from the transmit complete interrupt of the SYNC frame
+        void onSyncTransmitted(uint32_t now_us) {
+            if(!pending) return;
+            pending = false;
+            previous_tx = now_us;
+            previous_valid = true;
+            seq = nextSyncSeq(seq);
+        }
+
+        // Call if the SYNC frame was aborted or lost, so its time is not sent
+        void onSyncFailed() {
+            pending = false;
+            previous_valid = false;
+            seq = nextSyncSeq(seq);
+        }
+
+    private:
+        // Shared with the transmit interrupt
+        volatile uint8_t seq = 1;
+        volatile bool pending = false;
+        volatile bool previous_valid = false;
+        volatile uint32_t previous_tx = 0;
+};
+
+
+// Motor driver side
+class ClockSync {
+    public:
+        // Call from the receive interrupt with the local time the SYNC frame arrived
+        void onSync(const SyncMessage& sync, uint32_t local_rx_us) {
+            if(have_last && (sync.flags & CAN_SYNC_FLAG_PREVIOUS_VALID) && sync.seq == nextSyncSeq(last_seq)) {
+                update(last_rx_us, sync.previous_tx);
+            }
+            have_last = true;
+            last_seq = sync.seq;
+            last_rx_us = local_rx_us;
+        }
+
+        // Convert a local timestamp to the primary time base
+        uint32_t toPrimary(uint32_t local_us) const {
+            float elapsed = predict((int32_t) (local_us - ref_local));
+            return ref_primary + (int32_t) (elapsed + (elapsed >= 0 ? 0.5f : -0.5f));
+        }
+
+        bool synchronised() const { return updates >= SETTLE_UPDATES; }
+
+        int32_t lastError() const { return last_error; }    // Last measured model error [us]
+        float driftPpm() const { return drift * 1e6f; }     // Local clock drift w.r.t. the primary [ppm]
+
+        // SYNC that last arrived, with its local reception time (for synchronised sampling)
+        uint8_t lastSeq() const { return last_seq; }
+        uint32_t lastSyncLocal() const { return last_rx_us; }
+
+        // Timestamped encoder reply for a speed sampled at local_us (e.g. on the last SYNC)
+        EncoderFeedbackTimed makeFeedback(DEVICE_ID self, float speed, uint32_t local_us, bool on_sync) const {
+            float s = speed / Scale::WHEEL_SPEED;
+            if(s > INT16_MAX) s = INT16_MAX;
+            if(s < -INT16_MAX) s = -INT16_MAX;
+            return EncoderFeedbackTimed{self, (uint8_t) (on_sync ? last_seq : 0), (int16_t) s, toPrimary(local_us)};
+        }
+
+    private:
+        // Loop gains for the offset and drift estimates, per SYNC
+        static constexpr float GAIN_OFFSET = 0.5f;
+        static constexpr float GAIN_DRIFT = 0.02f;
+        static constexpr float DRIFT_MAX = 500e-6f;  // Crystal tolerance is far better than this
+        static constexpr uint8_t SETTLE_UPDATES = 8;
+
+        bool have_last = false;
+        uint8_t last_seq = 0;
+        uint32_t last_rx_us = 0;
+
+        uint32_t ref_local = 0;
+        uint32_t ref_primary = 0;
+        float ref_fraction = 0;     // Sub-microsecond part of ref_primary
+        float drift = 0;            // Primary time per local time - 1
+        int32_t last_error = 0;
+        uint8_t updates = 0;
+
+        // Primary time elapsed since the reference, for dt local time
+        float predict(int32_t dt) const {
+            return dt + drift * dt + ref_fraction;
+        }
+
+        void update(uint32_t local, uint32_t primary) {
+            if(updates == 0) {
+                ref_local = local;
+                ref_primary = primary;
+                updates++;
+                return;
+            }
+            int32_t dt = (int32_t) (local - ref_local);
+            float predicted = predict(dt);
+            float error = (int32_t) (primary - ref_primary) - predicted;
+            last_error = (int32_t) error;
+
+            // Move the reference forward, corrected by part of the error
+            float elapsed = predicted + GAIN_OFFSET * error;
+            int32_t whole = (int32_t) elapsed;
+            ref_primary += whole;
+            ref_fraction = elapsed - whole;
+            ref_local = local;
+            if(dt > 0) {
+                drift += GAIN_DRIFT * error / dt;
+                if(drift > DRIFT_MAX) drift = DRIFT_MAX;
+                if(drift < -DRIFT_MAX) drift = -DRIFT_MAX;
+            }
+            if(updates < SETTLE_UPDATES) updates++;
+        }
+};
+
+} // namespace CAN
@@ -0,0 +1,151 @@
+// Delft Mercurians
+// 2026-10-19
+
+// Typed encoding/decoding of CAN payloads to and from STM32::CAN::msg_t,
+// and a dispatch table from MESSAGE_ID to handler.
+
+#pragma once
+#include <string.h>
+#include <type_traits>
+#include "protocols_can.h"
+
+namespace CAN {
+
+// Message ID each payload type is sent with, specialise for new payloads
+template<typename T>
+struct Payload;
+
+template<>
+struct Payload<COMMAND> {
+    static constexpr MESSAGE_ID id = MESSAGE_ID::SET_COMMAND;
+};
+
+template<>
+struct Payload<MotorStatusMessage> {
+    static constexpr MESSAGE_ID id = MESSAGE_ID::STATUS;
+};
+
+template<>
+struct Payload<EncoderFeedback> {
+    static constexpr MESSAGE_ID id = MESSAGE_ID::ENCODER;
+};
+
+template<>
+struct Payload<EncoderFeedbackTimed> {
+    static constexpr MESSAGE_ID id = MESSAGE_ID::ENCODER_TIMED;
+};
+
+template<>
+struct Payload<SyncMessage> {
+    static constexpr MESSAGE_ID id = MESSAGE_ID::SYNC;
+};
+
+// Value_Return has no fixed ID, it is sent with generateMessageId(variable, ACCESS::MASK)
+
+// Encode a payload straight into a frame
+template<typename T>
+inline void encode(STM32::CAN::msg_t& frame, DEVICE_ID destination, MESSAGE_ID message, const T& payload) {
+    static_assert(sizeof(T) <= 8, "Payload exceeds maximum size");
+    static_assert(std::is_trivially_copyable<T>::value, "Payload must be trivially copyable");
+    frame.id = makeId(destination, message);
+    frame.len = sizeof(T);
+    frame.format = STM32::CAN::Standard;
+    frame.type = STM32::CAN::Data;
+    memcpy(frame.data, &payload, sizeof(T));
+}
+
+template<typename T>
+inline void encode(STM32::CAN::msg_t& frame, DEVICE_ID destination, const T& payload) {
+    encode(frame, destination, Payload<T>::id, payload);
+}
+
+// Encode a variable read/write/return
+inline void encodeVariable(STM32::CAN::msg_t& frame, DEVICE_ID destination, VARIABLE variable, ACCESS access, CAN_VARIABLE_TYPE value) {
+    encode(frame, destination, generateMessageId(variable, access), value);
+}
+
+// Decode a payload straight from a frame, false if the frame is too short
+template<typename T>
+inline bool decode(const STM32::CAN::msg_t& frame, T& payload) {
+    static_assert(sizeof(T) <= 8, "Payload exceeds maximum size");
+    static_assert(std::is_trivially_copyable<T>::value, "Payload must be trivially copyable");
+    if(frame.len < sizeof(T)) return false;
+    memcpy(&payload, frame.data, sizeof(T));
+    return true;
+}
+
+
+// Calls the handler registered for the MESSAGE_ID of a frame
+// N is the maximum number of registered handlers, lookup is a direct index either way
+template<uint8_t N = 16>
+class Dispatcher {
+    public:
+        typedef void (*RawHandler)(const STM32::CAN::msg_t& frame);
+
+        template<typename T>
+        using Handler = void (*)(DEVICE_ID destination, const T& payload);
+
+        Dispatcher() {
+            memset(slots, NO_SLOT, sizeof(slots));
+        }
+
+        // Handle the whole frame
+        bool on(MESSAGE_ID message, RawHandler fun) {
+            return add(message, &Dispatcher::callRaw, (void (*)()) fun);
+        }
+
+        // Handle a decoded payload, frames that are too short are ignored
+        template<typename T>
+        bool on(MESSAGE_ID message, Handler<T> fun) {
+            return add(message, &Dispatcher::callTyped<T>, (void (*)()) fun);
+        }
+
+        template<typename T>
+        bool on(Handler<T> fun) {
+            return on<T>(Payload<T>::id, fun);
+        }
+
+        // Returns false if there is no handler for this frame
+        bool dispatch(const STM32::CAN::msg_t& frame) const {
+            uint8_t slot = slots[(uint8_t) getMessageId(frame.id)];
+            if(slot == NO_SLOT) return false;
+            entries[slot].call(frame, entries[slot].fun);
+            return true;
+        }
+
+    private:
+        static constexpr uint8_t NO_SLOT = 0xFF;
+        static_assert(N < NO_SLOT);
+
+        struct Entry {
+            void (*call)(const STM32::CAN::msg_t&, void (*)());
+            void (*fun)();
+        };
+
+        uint8_t slots[256];
+        Entry entries[N];
+        uint8_t num_entries = 0;
+
+        bool add(MESSAGE_ID message, void (*call)(const STM32::CAN::msg_t&, void (*)()), void (*fun)()) {
+            uint8_t& slot = slots[(uint8_t) message];
+            if(slot == NO_SLOT) {
+                if(num_entries >= N) return false;
+                slot = num_entries++;
+            }
+            entries[slot] = Entry{call, fun};
+            return true;
+        }
+
+        static void callRaw(const STM32::CAN::msg_t& frame, void (*fun)()) {
+            ((RawHandler) fun)(frame);
+        }
+
+        template<typename T>
+        static void callTyped(const STM32::CAN::msg_t& frame, void (*fun)()) {
+            T payload;
+            if(!decode(frame, payload)) return;
+            ((Handler<T>) fun)(getDeviceId(frame.id), payload);
+        }
+};
+
+} // namespace CAN
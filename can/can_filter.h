@@ -0,0 +1,217 @@
+// Delft Mercurians
+// 2026-10-19
+
+// Compile-time generation of bxCAN acceptance filter banks
+//
+// A node lists the (device, message) pairs it wants to receive, generate() turns that
+// into filter banks that accept exactly those standard data frames, so the hardware
+// drops everything else instead of interrupting for it.
+// For 11 bit IDs the 16 bit scale always packs at least as well as the 32 bit scale,
+// so all banks use it: list mode holds 4 exact IDs, mask mode holds 2 ID/mask pairs.
+
+#pragma once
+#include <stddef.h>
+#include "protocols_can.h"
+
+namespace CAN::Filter {
+
+constexpr uint16_t ID_MASK = 0x7FF;
+
+// Accepts all IDs where (id & mask) == (match & mask)
+struct Subscription {
+    uint16_t match;
+    uint16_t mask;
+
+    constexpr bool accepts(uint16_t id) const {
+        return (id & mask) == (match & mask);
+    }
+};
+
+// One message to one device
+inline constexpr Subscription message(DEVICE_ID device, MESSAGE_ID message) {
+    return Subscription{makeId(device, message), ID_MASK};
+}
+
+// All messages to one device
+inline constexpr Subscription device(DEVICE_ID device) {
+    return Subscription{makeId(device, (MESSAGE_ID) 0), 0x700};
+}
+
+// All variable accesses of one type (READ, WRITE or return) to one device
+inline constexpr Subscription access(DEVICE_ID device, ACCESS access) {
+    return Subscription{makeId(device, (MESSAGE_ID) access), 0x7C0};
+}
+
+// One message to any device
+inline constexpr Subscription anyDevice(MESSAGE_ID message) {
+    return Subscription{makeId((DEVICE_ID) 0, message), 0x0FF};
+}
+
+// 16 bit filter layout: STID[10:0] RTR IDE EXID[17:15]
+// RTR and IDE are always compared, so only standard data frames pass
+inline constexpr uint16_t field(uint16_t id) {
+    return (uint16_t) ((id & ID_MASK) << 5);
+}
+constexpr uint16_t FIELD_RTR_IDE = (1 << 4) | (1 << 3);
+
+// Register values of one filter bank (FxR1, FxR2)
+struct Bank {
+    bool list_mode;     // Identifier list (FM1R bit set) or identifier mask mode
+    uint32_t fr1;
+    uint32_t fr2;
+
+    constexpr bool accepts(uint16_t id) const {
+        uint16_t f = field(id);
+        if(list_mode) {
+            return f == (uint16_t) fr1 || f == (uint16_t) (fr1 >> 16)
+                || f == (uint16_t) fr2 || f == (uint16_t) (fr2 >> 16);
+        }
+        // Low half is the ID, high half is the mask
+        return (f & (fr1 >> 16)) == ((uint16_t) fr1 & (fr1 >> 16))
+            || (f & (fr2 >> 16)) == ((uint16_t) fr2 & (fr2 >> 16));
+    }
+};
+
+template<size_t N>
+struct Config {
+    Bank banks[N] = {};
+    uint8_t count = 0;
+
+    constexpr bool accepts(uint16_t id) const {
+        for(uint8_t i = 0; i < count; i++) {
+            if(banks[i].accepts(id)) return true;
+        }
+        return false;
+    }
+
+    // Filter mode register bits, for banks starting at first_bank
+    constexpr uint32_t fm1r(uint8_t first_bank = 0) const {
+        uint32_t r = 0;
+        for(uint8_t i = 0; i < count; i++) {
+            if(banks[i].list_mode) r |= 1UL << (first_bank + i);
+        }
+        return r;
+    }
+
+    // Filter scale register bits (always 16 bit)
+    constexpr uint32_t fs1r(uint8_t /* first_bank */ = 0) const {
+        return 0;
+    }
+
+    // Filter activation register bits
+    constexpr uint32_t fa1r(uint8_t first_bank = 0) const {
+        return (count == 0 ? 0 : ((1UL << count) - 1)) << first_bank;
+    }
+};
+
+// Generate filter banks accepting exactly the union of all subscriptions
+template<size_t S>
+constexpr Config<(S + 1) / 2> generate(const Subscription (&subscriptions)[S]) {
+    Subscription subs[S] = {};
+    size_t n = 0;
+
+    // Normalise and drop duplicates
+    for(size_t i = 0; i < S; i++) {
+        Subscription s = {(uint16_t) (subscriptions[i].match & subscriptions[i].mask & ID_MASK), (uint16_t) (subscriptions[i].mask & ID_MASK)};
+        bool duplicate = false;
+        for(size_t j = 0; j < n; j++) {
+            if(subs[j].match == s.match && subs[j].mask == s.mask) duplicate = true;
+        }
+        if(!duplicate) subs[n++] = s;
+    }
+
+    // Merge pairs that differ in one compared bit, and drop entries covered by another
+    bool changed = true;
+    while(changed) {
+        changed = false;
+        for(size_t i = 0; i < n && !changed; i++) {
+            for(size_t j = 0; j < n && !changed; j++) {
+                if(i == j) continue;
+                const Subscription& a = subs[i];
+                const Subscription& b = subs[j];
+                bool covered = (b.mask & ~a.mask) == 0 && (a.match & b.mask) == b.match;
+                uint16_t diff = a.match ^ b.match;
+                bool mergeable = a.mask == b.mask && diff != 0 && (diff & (diff - 1)) == 0;
+                if(covered) {
+                    subs[i] = subs[--n];
+                    changed = true;
+                } else if(mergeable) {
+                    subs[i] = Subscription{(uint16_t) (a.match & ~diff), (uint16_t) (a.mask & ~diff)};
+                    subs[j] = subs[--n];
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    // Split in exact IDs (list mode) and masked IDs (mask mode)
+    uint16_t exact[S] = {};
+    Subscription masked[S] = {};
+    size_t n_exact = 0;
+    size_t n_masked = 0;
+    for(size_t i = 0; i < n; i++) {
+        if(subs[i].mask == ID_MASK) {
+            exact[n_exact++] = subs[i].match;
+        } else {
+            masked[n_masked++] = subs[i];
+        }
+    }
+    // A free mask slot can hold an exact ID, this saves a bank if one would be alone in a list bank
+    if(n_masked % 2 == 1 && n_exact % 4 == 1) {
+        masked[n_masked++] = Subscription{exact[--n_exact], ID_MASK};
+    }
+
+    Config<(S + 1) / 2> config;
+    for(size_t i = 0; i < n_masked; i += 2) {
+        const Subscription& a = masked[i];
+        const Subscription& b = masked[i + 1 < n_masked ? i + 1 : i];     // Repeat to fill the bank
+        config.banks[config.count++] = Bank{
+            false,
+            ((uint32_t) (field(a.mask) | FIELD_RTR_IDE) << 16) | field(a.match),
+            ((uint32_t) (field(b.mask) | FIELD_RTR_IDE) << 16) | field(b.match),
+        };
+    }
+    for(size_t i = 0; i < n_exact; i += 4) {
+        uint16_t f[4] = {};
+        for(size_t k = 0; k < 4; k++) {
+            f[k] = field(exact[i + k < n_exact ? i + k : i]);  // Repeat to fill the bank
+        }
+        config.banks[config.count++] = Bank{
+            true,
+            ((uint32_t) f[1] << 16) | f[0],
+            ((uint32_t) f[3] << 16) | f[2],
+        };
+    }
+    return config;
+}
+
+// Whether a configuration accepts exactly the union of the subscriptions
+template<size_t N, size_t S>
+constexpr bool verify(const Config<N>& config, const Subscription (&subscriptions)[S]) {
+    for(uint16_t id = 0; id <= ID_MASK; id++) {
+        bool expected = false;
+        for(size_t i = 0; i < S; i++) {
+            if(subscriptions[i].accepts(id)) expected = true;
+        }
+        if(config.accepts(id) != expected) return false;
+    }
+    return true;
+}
+
+// Example: a wheel driver, this is checked at compile time
+namespace Example {
+constexpr Subscription DRIVER_0[] = {
+    message(DEVICE_ID::BROADCAST, MESSAGE_ID::ESTOP),
+    message(DEVICE_ID::BROADCAST, MESSAGE_ID::STOP),
+    message(DEVICE_ID::BROADCAST, MESSAGE_ID::SYNC),
+    message(DEVICE_ID::BROADCAST, MESSAGE_ID::SET_COMMAND),
+    message(DEVICE_ID::BROADCAST, MESSAGE_ID::REQ_ANNOUNCE),
+    access(DEVICE_ID::DRIVER_0, ACCESS::READ),
+    access(DEVICE_ID::DRIVER_0, ACCESS::WRITE),
+};
+constexpr auto DRIVER_0_CONFIG = generate(DRIVER_0);
+static_assert(verify(DRIVER_0_CONFIG, DRIVER_0));
+static_assert(DRIVER_0_CONFIG.count == 3);
+} // namespace Example
+
+} // namespace CAN::Filter
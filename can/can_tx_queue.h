@@ -0,0 +1,210 @@
+// Delft Mercurians
+// 2026-10-19
+
+// Priority ordered transmit queue in front of the three bxCAN transmit mailboxes
+//
+// Frames wait in a queue ordered by CAN ID (lower is more important, equal IDs in order of
+// arrival) and are moved into a mailbox whenever one frees up. If all mailboxes hold less
+// important frames than the head of the queue, the least important one is aborted and queued
+// again, so ESTOP/STOP and wheel commands never wait behind a burst of variable replies.
+// Periodic setpoints can be sent with replace = true: a queued or still pending frame with
+// the same ID is then dropped instead of being sent late.
+
+#pragma once
+#include "protocols_can.h"
+
+namespace CAN {
+
+const uint8_t NUM_TX_MAILBOXES = 3;
+
+// Access to the transmit mailboxes, implemented by the firmware on top of the bxCAN registers
+struct TxMailboxes {
+    bool (*empty)(uint8_t mailbox);                                 // TSR.TMEx
+    void (*load)(uint8_t mailbox, const STM32::CAN::msg_t& frame);  // Fill TIxR/TDTxR/TDLxR/TDHxR, set TXRQ
+    void (*abort)(uint8_t mailbox);                                 // TSR.ABRQx, completion is reported as a failed transmission
+    void (*lock)() = nullptr;       // Mask the transmit interrupt (optional)
+    void (*unlock)() = nullptr;
+};
+
+// Latency from queuing to transmit complete, per priority class (top 3 bits of the ID)
+struct TxLatency {
+    uint32_t count = 0;
+    uint32_t total_us = 0;
+    uint32_t max_us = 0;
+
+    uint32_t average_us() const { return count == 0 ? 0 : total_us / count; }
+};
+
+template<uint8_t N = 16>
+class TxScheduler {
+    public:
+        TxScheduler(TxMailboxes hw) : hw{hw} { }
+
+        // Queue a frame, false if the queue is full
+        // replace: supersede a queued or pending frame with the same ID (e.g. the previous wheel command)
+        bool send(const STM32::CAN::msg_t& frame, uint32_t now_us, bool replace = false) {
+            Lock lock(hw);
+            if(replace) {
+                for(uint8_t m = 0; m < NUM_TX_MAILBOXES; m++) {
+                    if(mailbox[m].busy && !mailbox[m].superseded && mailbox[m].entry.frame.id == frame.id) {
+                        mailbox[m].superseded = true;
+                        hw.abort(m);
+                        superseded++;
+                    }
+                }
+                for(uint8_t i = 0; i < size; i++) {
+                    if(heap[i].frame.id == frame.id) {
+                        // Keep the position in the queue, only the contents are stale
+                        heap[i].frame = frame;
+                        heap[i].queued_us = now_us;
+                        superseded++;
+                        return true;
+                    }
+                }
+            }
+            if(size >= N) {
+                dropped++;
+                return false;
+            }
+            heap[size] = Entry{frame, now_us, order++};
+            siftUp(size++);
+            refillLocked();
+            return true;
+        }
+
+        // Call from the transmit complete interrupt, ok is false if the frame was aborted or failed
+        void onTransmitComplete(uint8_t m, bool ok, uint32_t now_us) {
+            Lock lock(hw);
+            if(m >= NUM_TX_MAILBOXES || !mailbox[m].busy) return;
+            Slot& slot = mailbox[m];
+            slot.busy = false;
+            if(ok) {
+                TxLatency& l = latency[priorityClass(slot.entry.frame.id)];
+                uint32_t dt = now_us - slot.entry.queued_us;
+                l.count++;
+                l.total_us += dt;
+                if(dt > l.max_us) l.max_us = dt;
+            } else if(!slot.superseded) {
+                // Pre-empted by a more important frame, try again later in the same position
+                if(size < N) {
+                    heap[size] = slot.entry;
+                    siftUp(size++);
+                } else {
+                    dropped++;
+                }
+            }
+            refillLocked();
+        }
+
+        // Move queued frames into free mailboxes, in case a completion was missed
+        void refill() {
+            Lock lock(hw);
+            refillLocked();
+        }
+
+        const TxLatency& getLatency(uint8_t priority_class) const { return latency[priority_class & 0x7]; }
+        static constexpr uint8_t priorityClass(uint32_t id) { return (id >> 8) & 0x7; }
+
+        uint8_t queued() const { return size; }
+        uint32_t droppedCount() const { return dropped; }          // Queue was full, also on a retry
+        uint32_t supersededCount() const { return superseded; }    // Replaced before they were sent
+
+    private:
+        struct Entry {
+            STM32::CAN::msg_t frame;
+            uint32_t queued_us;
+            uint32_t order;     // Arrival order, for equal IDs
+        };
+
+        struct Slot {
+            Entry entry;
+            bool busy = false;
+            bool aborting = false;
+            bool superseded = false;
+        };
+
+        struct Lock {
+            const TxMailboxes& hw;
+            Lock(const TxMailboxes& hw) : hw{hw} { if(hw.lock != nullptr) hw.lock(); }
+            ~Lock() { if(hw.unlock != nullptr) hw.unlock(); }
+        };
+
+        TxMailboxes hw;
+
+        Entry heap[N];
+        uint8_t size = 0;
+        uint32_t order = 0;
+        Slot mailbox[NUM_TX_MAILBOXES];
+
+        TxLatency latency[8];
+        uint32_t dropped = 0;
+        uint32_t superseded = 0;
+
+        static bool before(const Entry& a, const Entry& b) {
+            if(a.frame.id != b.frame.id) return a.frame.id < b.frame.id;
+            return (int32_t) (a.order - b.order) < 0;
+        }
+
+        void siftUp(uint8_t i) {
+            while(i > 0) {
+                uint8_t parent = (i - 1) / 2;
+                if(!before(heap[i], heap[parent])) break;
+                Entry t = heap[i]; heap[i] = heap[parent]; heap[parent] = t;
+                i = parent;
+            }
+        }
+
+        void siftDown(uint8_t i) {
+            while(true) {
+                uint8_t smallest = i;
+                uint8_t l = 2 * i + 1;
+                uint8_t r = 2 * i + 2;
+                if(l < size && before(heap[l], heap[smallest])) smallest = l;
+                if(r < size && before(heap[r], heap[smallest])) smallest = r;
+                if(smallest == i) break;
+                Entry t = heap[i]; heap[i] = heap[smallest]; heap[smallest] = t;
+                i = smallest;
+            }
+        }
+
+        void pop() {
+            heap[0] = heap[--size];
+            siftDown(0);
+        }
+
+        void refillLocked() {
+            while(size > 0) {
+                // Free mailbox: load the most important frame
+                uint8_t free = NUM_TX_MAILBOXES;
+                for(uint8_t m = 0; m < NUM_TX_MAILBOXES; m++) {
+                    if(!mailbox[m].busy && hw.empty(m)) {
+                        free = m;
+                        break;
+                    }
+                }
+                if(free < NUM_TX_MAILBOXES) {
+                    mailbox[free].entry = heap[0];
+                    mailbox[free].busy = true;
+                    mailbox[free].aborting = false;
+                    mailbox[free].superseded = false;
+                    hw.load(free, heap[0].frame);
+                    pop();
+                    continue;
+                }
+
+                // All busy: pre-empt the least important mailbox if the head of the queue beats it
+                uint8_t worst = NUM_TX_MAILBOXES;
+                for(uint8_t m = 0; m < NUM_TX_MAILBOXES; m++) {
+                    if(mailbox[m].aborting || mailbox[m].superseded) continue;
+                    if(worst == NUM_TX_MAILBOXES || mailbox[m].entry.frame.id > mailbox[worst].entry.frame.id) worst = m;
+                }
+                if(worst < NUM_TX_MAILBOXES && heap[0].frame.id < mailbox[worst].entry.frame.id) {
+                    mailbox[worst].aborting = true;
+                    hw.abort(worst);
+                }
+                return;
+            }
+        }
+};
+
+} // namespace CAN
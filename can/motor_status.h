@@ -0,0 +1,176 @@
+// Delft Mercurians
+// 2026-10-19
+
+// Latest status, speed and current of every motor driver, with the time it was received
+//
+// CAN frames from the drivers arrive at any time, handle() stores them already scaled for the
+// radio, so filling a PrimaryStatusHF/LF is a copy of a few arrays and an age check per motor.
+// A motor is reported as HG::Status::NO_REPLY when its status is older than the status deadline,
+// or when encoder or current feedback it was sending is older than the feedback deadline, so a
+// dead driver is caught within a control period. Stale speeds and currents are reported as 0.
+// Feedback that stops for another reason (e.g. no more commands) also reads as NO_REPLY.
+//
+// The radio messages are passed in by the caller, so CAN does not depend on the radio.
+//
+// handle() and fillHF()/fillLF() are not safe against each other, call both from the loop
+// (or mask the CAN interrupt around them).
+
+#pragma once
+#include "can_codec.h"
+#include "../scaling.h"
+
+namespace CAN {
+
+class MotorStatusAggregator {
+    public:
+        static constexpr uint8_t NUM_MOTORS = 5;    // DRIVER_0 -> DRIVER_3, DRIVER_A
+        static constexpr int8_t NO_MOTOR = -1;
+
+        // Index in the motor arrays of the status messages, NO_MOTOR for other devices
+        static constexpr int8_t motorIndex(DEVICE_ID device) {
+            return device >= DEVICE_ID::DRIVER_0 && device <= DEVICE_ID::DRIVER_A
+                ? (int8_t) device - (int8_t) DEVICE_ID::DRIVER_0 : NO_MOTOR;
+        }
+
+        // status_deadline_us: drivers send STATUS periodically, NO_REPLY if none was received in this time
+        // feedback_deadline_us: speed and current are at most this old, 1.5 control periods so one late frame is allowed
+        MotorStatusAggregator(uint32_t status_deadline_us = 100000, uint32_t feedback_deadline_us = 1500)
+            : status_deadline_us{status_deadline_us}, feedback_deadline_us{feedback_deadline_us}
+        {
+            for(uint8_t i = 0; i < NUM_MOTORS; i++) {
+                status[i] = HG::Status::NO_REPLY;
+                temps[i] = 0;
+                speeds[i] = 0;
+                currents[i] = 0;
+                status_us[i] = 0;
+                speed_us[i] = 0;
+                current_us[i] = 0;
+            }
+        }
+
+        // Returns true if the frame was a driver status, encoder or current reading
+        bool handle(const STM32::CAN::msg_t& frame, uint32_t now_us) {
+            switch(getMessageId(frame.id)) {
+                case MESSAGE_ID::STATUS: {
+                    MotorStatusMessage m;
+                    if(!decode(frame, m)) return false;
+                    int8_t i = motorIndex(m.txId);
+                    if(i == NO_MOTOR) return false;
+                    status[i] = m.ms.status;
+                    temps[i] = m.ms.temp < 0 ? 0 : (uint8_t) m.ms.temp;   // Both scaled by Scale::MD_TEMP
+                    status_us[i] = now_us;
+                    received |= 1 << i;
+                    return true;
+                }
+                case MESSAGE_ID::ENCODER: {
+                    EncoderFeedback m;
+                    if(!decode(frame, m)) return false;
+                    return speedReceived(m.txId, m.speed, now_us);
+                }
+                case MESSAGE_ID::ENCODER_TIMED: {
+                    EncoderFeedbackTimed m;
+                    if(!decode(frame, m)) return false;
+                    int8_t i = motorIndex(m.txId);
+                    if(i == NO_MOTOR) return false;
+                    speeds[i] = m.speed;
+                    speed_us[i] = now_us;
+                    speed_received |= 1 << i;
+                    return true;
+                }
+                default:
+                    break;
+            }
+            if(getMessageId(frame.id) != generateMessageId(VARIABLE::CURRENT_MES, ACCESS::MASK)) return false;
+            Value_Return m;
+            if(!decode(frame, m)) return false;
+            return currentReceived(m.txId, m.value, now_us);
+        }
+
+        bool speedReceived(DEVICE_ID device, float speed, uint32_t now_us) {
+            int8_t i = motorIndex(device);
+            if(i == NO_MOTOR) return false;
+            speeds[i] = scale(speed, Scale::WHEEL_SPEED);
+            speed_us[i] = now_us;
+            speed_received |= 1 << i;
+            return true;
+        }
+
+        bool currentReceived(DEVICE_ID device, float current, uint32_t now_us) {
+            int8_t i = motorIndex(device);
+            if(i == NO_MOTOR) return false;
+            currents[i] = scale(current, Scale::CURRENT);
+            current_us[i] = now_us;
+            current_received |= 1 << i;
+            return true;
+        }
+
+        // Speeds and currents of a Radio::PrimaryStatusHF
+        template<typename StatusHF>
+        void fillHF(StatusHF& hf, uint32_t now_us) const {
+            for(uint8_t i = 0; i < NUM_MOTORS; i++) {
+                hf.motor_speeds_i[i] = now_us - speed_us[i] <= feedback_deadline_us ? speeds[i] : 0;
+                hf.motor_currents_i[i] = now_us - current_us[i] <= feedback_deadline_us ? currents[i] : 0;
+            }
+        }
+
+        // Motor status and temperatures of a Radio::PrimaryStatusLF
+        template<typename StatusLF>
+        void fillLF(StatusLF& lf, uint32_t now_us) const {
+            for(uint8_t i = 0; i < NUM_MOTORS; i++) {
+                bool alive = !stale(i, now_us);
+                lf.motor_status[i] = alive ? status[i] : HG::Status::NO_REPLY;
+                lf.motor_driver_temps[i] = alive ? temps[i] : 0;
+            }
+        }
+
+        // Whether the status of a motor is missing or older than the deadline, or its feedback stopped
+        bool stale(uint8_t motor, uint32_t now_us) const {
+            uint8_t bit = 1 << motor;
+            if(!(received & bit) || now_us - status_us[motor] > status_deadline_us) return true;
+            if((speed_received & bit) && now_us - speed_us[motor] > feedback_deadline_us) return true;
+            return (current_received & bit) && now_us - current_us[motor] > feedback_deadline_us;
+        }
+
+        // Bit per motor that is not replying
+        uint8_t staleMask(uint32_t now_us) const {
+            uint8_t mask = 0;
+            for(uint8_t i = 0; i < NUM_MOTORS; i++) {
+                if(stale(i, now_us)) mask |= 1 << i;
+            }
+            return mask;
+        }
+
+        uint32_t statusAge(uint8_t motor, uint32_t now_us) const { return now_us - status_us[motor]; }
+        uint32_t speedAge(uint8_t motor, uint32_t now_us) const { return now_us - speed_us[motor]; }
+
+    private:
+        uint32_t status_deadline_us;
+        uint32_t feedback_deadline_us;
+
+        // Latest values, scaled like in the radio messages
+        HG::Status status[NUM_MOTORS];
+        uint8_t temps[NUM_MOTORS];
+        int16_t speeds[NUM_MOTORS];
+        int16_t currents[NUM_MOTORS];
+        uint8_t received = 0;   // Bit per motor that sent a status at least once
+        uint8_t speed_received = 0;
+        uint8_t current_received = 0;
+
+        // Receive times
+        uint32_t status_us[NUM_MOTORS];
+        uint32_t speed_us[NUM_MOTORS];
+        uint32_t current_us[NUM_MOTORS];
+
+        static int16_t scale(float value, float lsb) {
+            float v = value / lsb;
+            if(v > INT16_MAX) return INT16_MAX;
+            if(v < -INT16_MAX) return -INT16_MAX;
+            return (int16_t) (v < 0 ? v - 0.5f : v + 0.5f);
+        }
+};
+
+static_assert(MotorStatusAggregator::motorIndex(DEVICE_ID::DRIVER_0) == 0);
+static_assert(MotorStatusAggregator::motorIndex(DEVICE_ID::DRIVER_A) == 4);
+static_assert(MotorStatusAggregator::motorIndex(DEVICE_ID::PRIMARY) == MotorStatusAggregator::NO_MOTOR);
+
+} // namespace CAN
@@ -19,16 +19,17 @@
 
 namespace CAN {
 
+// Legacy macros, prefer the typed constexpr functions below (generateMessageId, makeId, getMessageId, getDeviceId)
 // Make message IDs from variable and access type
-#define CAN_GENERATE_MESSAGE_ID_(variable, access) ((uint32_t) variable | (uint32_t) access)
-#define CAN_GENERATE_MESSAGE_ID(variable, access) (::CAN::MESSAGE_ID) (CAN_GENERATE_MESSAGE_ID_(variable, access))
+#define CAN_GENERATE_MESSAGE_ID_(variable, access) ::CAN::generateMessageId_((::CAN::VARIABLE) (variable), (::CAN::ACCESS) (access))
+#define CAN_GENERATE_MESSAGE_ID(variable, access) ::CAN::generateMessageId((::CAN::VARIABLE) (variable), (::CAN::ACCESS) (access))
 
 // Make full ID from destination device and message type
-#define CAN_MAKE_ID(Device, Message)     (((uint16_t) Device<<8) | (uint16_t) Message)
+#define CAN_MAKE_ID(Device, Message)     ::CAN::makeId((::CAN::DEVICE_ID) (Device), (::CAN::MESSAGE_ID) (Message))
 
 // Extract message and device ids from full ID
-#define CAN_MAKE_MESSAGE_ID(CanID)            (::CAN::MESSAGE_ID) (CanID & 0xff)
-#define CAN_GET_DEVICE_ID(CanID)             (::CAN::DEVICE_ID) (CanID>>8)
+#define CAN_MAKE_MESSAGE_ID(CanID)            ::CAN::getMessageId(CanID)
+#define CAN_GET_DEVICE_ID(CanID)             ::CAN::getDeviceId(CanID)
 
 #define UPPER_LIMIT (1e5)
 #define LOWER_LIMIT (-UPPER_LIMIT)
@@ -143,6 +144,29 @@ struct EncoderFeedback {
 static_assert(sizeof(EncoderFeedback) <= 8, "EncoderFeedback exceeds maximum size");
 // *******
 
+// Motor encoder message, sampled at a known time
+struct EncoderFeedbackTimed {
+    DEVICE_ID txId;         // transmitting device
+    uint8_t sync_seq;       // SYNC the speed was sampled on (synchronised sampling), otherwise 0
+    int16_t speed;          // encoder measured speed, scaled by Scale::WHEEL_SPEED
+    uint32_t timestamp;     // sample time in the primary time base [us]
+};
+static_assert(sizeof(EncoderFeedbackTimed) <= 8, "EncoderFeedbackTimed exceeds maximum size");
+// *******
+
+// Clock synchronisation message, broadcast periodically by the primary
+// The exact transmit time of a SYNC is only known after it was sent, so it is carried by the next one
+#define CAN_SYNC_FLAG_PREVIOUS_VALID (1 << 0)   // previous_tx is the transmit time of SYNC seq - 1
+#define CAN_SYNC_FLAG_SAMPLE (1 << 1)           // Drivers sample their encoders on reception and reply with EncoderFeedbackTimed
+struct SyncMessage {
+    uint8_t seq;            // Incremented with every SYNC, skipping 0 (see EncoderFeedbackTimed)
+    uint8_t flags;          // CAN_SYNC_FLAG_*
+    uint8_t _pad[2];
+    uint32_t previous_tx;   // Primary time the previous SYNC was transmitted [us]
+};
+static_assert(sizeof(SyncMessage) <= 8, "SyncMessage exceeds maximum size");
+// *******
+
 
 // Type of variable access
 enum class ACCESS {
@@ -151,6 +175,11 @@ enum class ACCESS {
     MASK = 0xC0,
 };
 
+// Make message IDs from variable and access type
+inline constexpr uint8_t generateMessageId_(VARIABLE variable, ACCESS access) {
+    return ((uint8_t) variable & (uint8_t) VARIABLE::MASK) | (uint8_t) access;
+}
+
 
 // Combines all message types in one. Some options are not explicitly named here (0x00 -> 0xFF, 8 bits)
 // 0x00 -> 0x3F are general commands
@@ -163,9 +192,16 @@ enum class MESSAGE_ID {
 
     ACK = 0x05,             // Acknowledge messages
 
+    ENCODER_TIMED = 0x0C,   // Encoder speed with sample time <EncoderFeedbackTimed>
+
     LED_SET_DUTY = 0x11,    // Set led blink duty cycle ** defunct, might remove
 
-    SYNC = 0x36,            // Synchronise clocks
+    BLOCK_WRITE = 0x20,     // Start a block write session <BlockStart>
+    BLOCK_READ = 0x21,      // Request a range of variables <BlockStart>
+    BLOCK_DATA = 0x22,      // One variable of a block session <BlockData>
+    BLOCK_ACK = 0x23,       // Block session result <BlockAck>
+
+    SYNC = 0x36,            // Synchronise clocks <SyncMessage>
 
     ESTOP = 0x3F,           // Emergency stop all drivers (highest priority) ** Priorities have changed
     STOP = 0x30,            // Gracefull stop all drivers (high priority) ** Priorities have changed
@@ -184,11 +220,44 @@ enum class MESSAGE_ID {
     RETURN_POSITION_MES = CAN_GENERATE_MESSAGE_ID_(VARIABLE::POSITION_MES, ACCESS::MASK),
     RETURN_SPEED_MES = CAN_GENERATE_MESSAGE_ID_(VARIABLE::SPEED_MES, ACCESS::MASK),
 
+    SET_COMMAND = CAN_GENERATE_MESSAGE_ID_(VARIABLE::COMMAND, ACCESS::WRITE),   // Set all wheel speeds at once <COMMAND>
+
     STATUS = CAN_GENERATE_MESSAGE_ID_(VARIABLE::STATUS, ACCESS::MASK),
     ENCODER = CAN_GENERATE_MESSAGE_ID_(VARIABLE::ENCODER, ACCESS::MASK),
     
 };
 
+inline constexpr MESSAGE_ID generateMessageId(VARIABLE variable, ACCESS access) {
+    return (MESSAGE_ID) generateMessageId_(variable, access);
+}
+
+// Make full (11 bit) ID from destination device and message type
+inline constexpr uint16_t makeId(DEVICE_ID device, MESSAGE_ID message) {
+    return (((uint16_t) device & 0x7) << 8) | ((uint16_t) message & 0xFF);
+}
+
+// Extract message and device ids from full ID
+inline constexpr MESSAGE_ID getMessageId(uint32_t can_id) {
+    return (MESSAGE_ID) (can_id & 0xFF);
+}
+inline constexpr DEVICE_ID getDeviceId(uint32_t can_id) {
+    return (DEVICE_ID) ((can_id >> 8) & 0x7);
+}
+
+// Split variable access message IDs, ACCESS is 0 for general commands
+inline constexpr VARIABLE getVariable(MESSAGE_ID message) {
+    return (VARIABLE) ((uint8_t) message & (uint8_t) VARIABLE::MASK);
+}
+inline constexpr ACCESS getAccess(MESSAGE_ID message) {
+    return (ACCESS) ((uint8_t) message & (uint8_t) ACCESS::MASK);
+}
+
+static_assert(makeId(DEVICE_ID::DRIVER_2, MESSAGE_ID::ENCODER) == 0x3CB);
+static_assert(getDeviceId(makeId(DEVICE_ID::AUXILIARY, MESSAGE_ID::ESTOP)) == DEVICE_ID::AUXILIARY);
+static_assert(getMessageId(makeId(DEVICE_ID::PRIMARY, MESSAGE_ID::SET_SPEED)) == MESSAGE_ID::SET_SPEED);
+static_assert(getVariable(MESSAGE_ID::GET_SPEED_MES) == VARIABLE::SPEED_MES);
+static_assert(getAccess(MESSAGE_ID::RETURN_SPEED_MES) == ACCESS::MASK);
+
 
 // Used to send variables back to answer a request
 struct Value_Return {
@@ -198,6 +267,45 @@ struct Value_Return {
 
 static_assert(sizeof(Value_Return) <= 8, "Value_Return exceeds maximum size");
 
+
+// Block transfers stream many variables in consecutive frames with a single acknowledge
+// Write: BLOCK_WRITE, count x BLOCK_DATA -> BLOCK_ACK (values are applied together once all arrived)
+// Read:  BLOCK_READ -> BLOCK_DATA for every readable variable in the range, BLOCK_ACK
+#define CAN_BLOCK_MAX_VARIABLES 64
+
+enum class BlockStatus : uint8_t {
+    OK = 0x00,          // All frames received and applied/sent
+    INCOMPLETE = 0x01,  // Frames are missing, resend starting at BlockAck::received
+    REJECTED = 0x02,    // Session too long, or at least one variable could not be written
+    BUSY = 0x03,        // Another session is in progress
+};
+
+struct BlockStart {
+    uint8_t session;    // Session number, repeated in every frame of the session
+    uint8_t count;      // Write: number of BLOCK_DATA frames that follow, read: number of variables in the range
+    uint8_t first;      // Read: first VARIABLE of the range
+    uint8_t _pad[5];
+};
+static_assert(sizeof(BlockStart) <= 8, "BlockStart exceeds maximum size");
+
+struct BlockData {
+    uint8_t session;
+    uint8_t seq;                // Position in the session
+    uint8_t variable;           // VARIABLE
+    uint8_t _pad;
+    CAN_VARIABLE_TYPE value;
+};
+static_assert(sizeof(BlockData) <= 8, "BlockData exceeds maximum size");
+
+struct BlockAck {
+    DEVICE_ID txId;     // transmitting device
+    uint8_t session;
+    uint8_t received;   // Number of frames received (write) or sent (read) in order
+    BlockStatus status;
+    uint8_t _pad[4];
+};
+static_assert(sizeof(BlockAck) <= 8, "BlockAck exceeds maximum size");
+
 }
 
 
@@ -0,0 +1,450 @@
+// Delft Mercurians
+// 2026-10-19
+
+// Virtual CAN bus to run the CAN protocol on a host, without any boards
+//
+// A discrete event simulation of one bus: nodes (a primary, motor drivers, ...) are objects
+// that are ticked at the times they ask for and exchange STM32::CAN::msg_t frames. Frames
+// take exactly as long as on a real bus, including stuff bits, and arbitration compares the
+// arbitration fields bit by bit, so standard and extended frames mix correctly. Like on a real
+// bus, two nodes sending the same ID with different data is a bit error for both of them.
+// Errors can be injected at random or on demand, transmit error counters follow the spec
+// (error passive at 128, bus off at 256).
+//
+// Everything runs in one thread and is deterministic for a given seed. Threads or coroutines
+// can be mapped onto nodes by having tick() resume them.
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "can_bus_load.h"
+
+#ifndef CAN_VIRTUAL_MAX_NODES
+  #define CAN_VIRTUAL_MAX_NODES 8
+#endif
+
+namespace CAN::Virtual {
+
+constexpr uint64_t NEVER = UINT64_MAX;
+
+inline constexpr uint64_t bitTimeNs(STM32::CAN::Bitrate bitrate) {
+    return 1000000000ull / STM32::CAN::SPEED[bitrate];
+}
+
+// Bits of a frame from SOF up to and including the CRC, before stuffing
+class Bitstream {
+    public:
+        Bitstream(const STM32::CAN::msg_t& f) {
+            uint8_t len = f.len > 8 ? 8 : f.len;
+            bool remote = f.type == STM32::CAN::Remote;
+            push(0, 1);                                 // SOF
+            if(f.format == STM32::CAN::Extended) {
+                push(f.id >> 18, 11);                   // Base ID
+                push(1, 1);                             // SRR
+                push(1, 1);                             // IDE
+                push(f.id, 18);                         // Extended ID
+                push(remote, 1);                        // RTR
+                push(0, 2);                             // r1, r0
+            } else {
+                push(f.id, 11);
+                push(remote, 1);                        // RTR
+                push(0, 2);                             // IDE, r0
+            }
+            push(len, 4);                               // DLC
+            if(!remote) {
+                for(uint8_t i = 0; i < len; i++) push(f.data[i], 8);
+            }
+            push(crc15(), 15);
+        }
+
+        uint8_t size() const { return length; }
+        bool operator[](uint8_t i) const { return (bits[i / 8] >> (7 - i % 8)) & 1; }
+
+        // Stuff bits inserted after every 5 equal bits
+        uint8_t stuffBits() const {
+            uint8_t stuffed = 0, run = 0;
+            bool last = true;
+            for(uint8_t i = 0; i < length; i++) {
+                if((*this)[i] == last) {
+                    run++;
+                } else {
+                    last = (*this)[i];
+                    run = 1;
+                }
+                if(run == 5) {
+                    // The stuff bit is the opposite level and starts the next run
+                    stuffed++;
+                    last = !last;
+                    run = 1;
+                }
+            }
+            return stuffed;
+        }
+
+    private:
+        uint8_t bits[16] = {};
+        uint8_t length = 0;
+
+        void push(uint32_t value, uint8_t n) {
+            for(int8_t i = n - 1; i >= 0; i--) {
+                if((value >> i) & 1) bits[length / 8] |= 0x80 >> (length % 8);
+                length++;
+            }
+        }
+
+        uint16_t crc15() const {
+            uint16_t crc = 0;
+            for(uint8_t i = 0; i < length; i++) {
+                bool next = (*this)[i] ^ ((crc >> 14) & 1);
+                crc = (crc << 1) & 0x7FFF;
+                if(next) crc ^= 0x4599;
+            }
+            return crc;
+        }
+};
+
+// Exact length of a frame on the bus, including stuffing, CRC delimiter, ACK, EOF and interframe space
+inline uint32_t frameBits(const STM32::CAN::msg_t& frame) {
+    Bitstream bits(frame);
+    return bits.size() + bits.stuffBits() + 1 + 2 + 7 + 3;
+}
+
+// Arbitration field as a number, the lowest one wins arbitration
+inline uint32_t arbitrationKey(const STM32::CAN::msg_t& f) {
+    uint32_t rtr = f.type == STM32::CAN::Remote;
+    if(f.format == STM32::CAN::Extended) {
+        return ((f.id >> 18) & 0x7FF) << 21 | 1 << 20 | 1 << 19 | (f.id & 0x3FFFF) << 1 | rtr;
+    }
+    return (f.id & 0x7FF) << 21 | rtr << 20;
+}
+
+
+class Bus;
+
+// A device on the bus, override what is needed
+class Node {
+    public:
+        virtual ~Node() = default;
+
+        // Called at the time returned by the previous call (0 at the start), returns the next wake up time
+        virtual uint64_t tick(Bus& bus, uint64_t now_ns) { (void) bus; (void) now_ns; return NEVER; }
+
+        // A frame sent by another node was received
+        virtual void receive(Bus& bus, const STM32::CAN::msg_t& frame, uint64_t now_ns) { (void) bus; (void) frame; (void) now_ns; }
+
+        // A frame of this node was sent
+        virtual void transmitted(Bus& bus, const STM32::CAN::msg_t& frame, uint64_t queued_ns, uint64_t now_ns) {
+            (void) bus; (void) frame; (void) queued_ns; (void) now_ns;
+        }
+
+        // Queue a frame in one of the three transmit mailboxes, false if they are all busy
+        bool send(const STM32::CAN::msg_t& frame, uint64_t now_ns) {
+            if(bus_off) return false;
+            for(uint8_t m = 0; m < NUM_MAILBOXES; m++) {
+                if(mailbox[m].busy) continue;
+                mailbox[m] = Mailbox{frame, now_ns, true};
+                return true;
+            }
+            return false;
+        }
+
+        uint16_t transmitErrors() const { return tec; }
+        bool errorPassive() const { return tec >= 128; }
+        bool busOff() const { return bus_off; }
+
+    private:
+        friend class Bus;
+        static constexpr uint8_t NUM_MAILBOXES = 3;
+
+        struct Mailbox {
+            STM32::CAN::msg_t frame;
+            uint64_t queued_ns;
+            bool busy;
+        };
+
+        Mailbox mailbox[NUM_MAILBOXES] = {};
+        uint64_t wake_ns = 0;
+        uint64_t suspend_until_ns = 0;  // Error passive nodes wait 8 bits after transmitting
+        uint16_t tec = 0;
+        bool bus_off = false;
+
+        // Mailbox with the highest priority frame, like the bxCAN with TXFP = 0
+        int8_t nextMailbox() const {
+            int8_t best = -1;
+            for(uint8_t m = 0; m < NUM_MAILBOXES; m++) {
+                if(!mailbox[m].busy) continue;
+                if(best < 0 || arbitrationKey(mailbox[m].frame) < arbitrationKey(mailbox[best].frame)) best = m;
+            }
+            return best;
+        }
+};
+
+
+class Bus {
+    public:
+        struct Statistics {
+            uint32_t frames = 0;
+            uint32_t errors = 0;        // Error frames, injected or collisions
+            uint32_t collisions = 0;    // Same ID with different data
+            uint64_t busy_ns = 0;
+            uint64_t max_latency_ns = 0;    // From queuing until transmit complete
+            uint64_t total_latency_ns = 0;
+        };
+
+        Bus(STM32::CAN::Bitrate bitrate) : bit_ns{bitTimeNs(bitrate)} { }
+
+        bool attach(Node& node) {
+            if(num_nodes >= CAN_VIRTUAL_MAX_NODES) return false;
+            nodes[num_nodes++] = &node;
+            return true;
+        }
+
+        // Corrupt every frame with this probability
+        void setErrorRate(float per_frame, uint32_t seed = 1) {
+            error_rate = per_frame;
+            random = seed == 0 ? 1 : seed;
+        }
+
+        // Corrupt the next n frames
+        void injectErrors(uint32_t n) { inject += n; }
+
+        // Run the bus until the given time
+        void run(uint64_t until_ns) {
+            while(now_ns < until_ns) {
+                wakeNodes(now_ns + 1);
+
+                // Arbitration between the frames that are ready now
+                Node* winners[CAN_VIRTUAL_MAX_NODES];
+                int8_t boxes[CAN_VIRTUAL_MAX_NODES];
+                uint8_t num_winners = 0;
+                uint32_t best = UINT32_MAX;
+                for(uint8_t n = 0; n < num_nodes; n++) {
+                    Node& node = *nodes[n];
+                    if(node.bus_off || node.suspend_until_ns > now_ns) continue;
+                    int8_t m = node.nextMailbox();
+                    if(m < 0) continue;
+                    uint32_t key = arbitrationKey(node.mailbox[m].frame);
+                    if(key < best) {
+                        best = key;
+                        num_winners = 0;
+                    }
+                    if(key == best) {
+                        winners[num_winners] = &node;
+                        boxes[num_winners++] = m;
+                    }
+                }
+
+                if(num_winners == 0) {
+                    now_ns = nextEvent(until_ns);
+                    continue;
+                }
+
+                const STM32::CAN::msg_t& frame = winners[0]->mailbox[boxes[0]].frame;
+                uint32_t bits = frameBits(frame);
+
+                // Error: the frame is cut off by an error flag (6) and delimiter (8), then retried
+                uint32_t error_at = 0;
+                for(uint8_t w = 1; w < num_winners; w++) {
+                    const STM32::CAN::msg_t& other = winners[w]->mailbox[boxes[w]].frame;
+                    if(other.len != frame.len || memcmp(other.data, frame.data, frame.len > 8 ? 8 : frame.len) != 0) {
+                        error_at = 19 + 8 * firstDifference(frame, other);
+                        statistics_.collisions++;
+                        break;
+                    }
+                }
+                if(error_at == 0 && corrupt()) error_at = 1 + nextRandom() % (bits - 13);
+
+                if(error_at != 0) {
+                    uint64_t end_ns = now_ns + (error_at + 6 + 8 + 3) * bit_ns;
+                    wakeNodes(end_ns);
+                    statistics_.errors++;
+                    statistics_.busy_ns += end_ns - now_ns;
+                    for(uint8_t w = 0; w < num_winners; w++) {
+                        Node& node = *winners[w];
+                        node.tec += 8;
+                        if(node.tec >= 256) {
+                            node.bus_off = true;
+                            for(auto& m : node.mailbox) m.busy = false;
+                        }
+                        if(node.errorPassive()) node.suspend_until_ns = end_ns + 8 * bit_ns;
+                    }
+                    now_ns = end_ns;
+                    continue;
+                }
+
+                uint64_t end_ns = now_ns + bits * bit_ns;
+                wakeNodes(end_ns);
+                statistics_.frames += num_winners;
+                statistics_.busy_ns += end_ns - now_ns;
+                now_ns = end_ns;
+
+                STM32::CAN::msg_t sent = frame;
+                for(uint8_t w = 0; w < num_winners; w++) {
+                    Node& node = *winners[w];
+                    uint64_t queued_ns = node.mailbox[boxes[w]].queued_ns;
+                    node.mailbox[boxes[w]].busy = false;
+                    if(node.tec > 0) node.tec--;
+                    if(node.errorPassive()) node.suspend_until_ns = now_ns + 8 * bit_ns;
+                    uint64_t latency = now_ns - queued_ns;
+                    statistics_.total_latency_ns += latency;
+                    if(latency > statistics_.max_latency_ns) statistics_.max_latency_ns = latency;
+                    node.transmitted(*this, sent, queued_ns, now_ns);
+                }
+                for(uint8_t n = 0; n < num_nodes; n++) {
+                    bool sender = false;
+                    for(uint8_t w = 0; w < num_winners; w++) sender |= winners[w] == nodes[n];
+                    if(!sender && !nodes[n]->bus_off) nodes[n]->receive(*this, sent, now_ns);
+                }
+            }
+        }
+
+        uint64_t now() const { return now_ns; }
+        uint64_t bitTime() const { return bit_ns; }
+        const Statistics& statistics() const { return statistics_; }
+
+        // Fraction of the time the bus was busy (0 -> 1)
+        float load() const { return now_ns == 0 ? 0 : (float) statistics_.busy_ns / now_ns; }
+
+    private:
+        uint64_t bit_ns;
+        uint64_t now_ns = 0;
+        Node* nodes[CAN_VIRTUAL_MAX_NODES];
+        uint8_t num_nodes = 0;
+
+        float error_rate = 0;
+        uint32_t inject = 0;
+        uint32_t random = 1;
+
+        Statistics statistics_;
+
+        // Tick every node that is due before the given time, in order of wake up time
+        void wakeNodes(uint64_t before_ns) {
+            while(true) {
+                Node* next = nullptr;
+                for(uint8_t n = 0; n < num_nodes; n++) {
+                    if(nodes[n]->wake_ns < before_ns && (next == nullptr || nodes[n]->wake_ns < next->wake_ns)) next = nodes[n];
+                }
+                if(next == nullptr) return;
+                uint64_t t = next->wake_ns;
+                uint64_t wake = next->tick(*this, t);
+                next->wake_ns = wake > t ? wake : t + 1;
+            }
+        }
+
+        uint64_t nextEvent(uint64_t until_ns) const {
+            uint64_t t = until_ns;
+            for(uint8_t n = 0; n < num_nodes; n++) {
+                if(nodes[n]->wake_ns < t) t = nodes[n]->wake_ns;
+                if(nodes[n]->suspend_until_ns > now_ns && nodes[n]->suspend_until_ns < t) t = nodes[n]->suspend_until_ns;
+            }
+            return t > now_ns ? t : now_ns + 1;
+        }
+
+        static uint8_t firstDifference(const STM32::CAN::msg_t& a, const STM32::CAN::msg_t& b) {
+            uint8_t i = 0;
+            while(i < 8 && a.data[i] == b.data[i]) i++;
+            return i;
+        }
+
+        bool corrupt() {
+            if(inject > 0) {
+                inject--;
+                return true;
+            }
+            return error_rate > 0 && (nextRandom() & 0xFFFFFF) < (uint32_t) (error_rate * 0x1000000);
+        }
+
+        // xorshift32
+        uint32_t nextRandom() {
+            random ^= random << 13;
+            random ^= random >> 17;
+            random ^= random << 5;
+            return random;
+        }
+};
+
+
+// Runs a BusLoad schedule on the virtual bus, one node per message, and measures the response times
+// Compare with BusLoad::analyse, which gives the worst case instead of what actually happens
+struct ScheduleResult {
+    uint32_t sent = 0;
+    uint32_t overruns = 0;      // Previous instance was still queued when the next one was due
+    uint64_t max_latency_ns = 0;
+    uint64_t total_latency_ns = 0;
+
+    uint64_t averageLatencyNs() const { return sent == 0 ? 0 : total_latency_ns / sent; }
+};
+
+class ScheduleNode : public Node {
+    public:
+        ScheduleNode() = default;
+        ScheduleNode(const BusLoad::PeriodicMessage& message, uint8_t index, uint32_t seed)
+            : message{message}, index{index}, random{seed == 0 ? 1 : seed}
+        { }
+
+        uint64_t tick(Bus& bus, uint64_t now_ns) override {
+            STM32::CAN::msg_t frame = {};
+            frame.id = message.id;
+            frame.len = message.len;
+            frame.data[0] = index;      // Different nodes send different data
+            frame.data[1] = (uint8_t) sequence++;
+            if(pending || !send(frame, now_ns)) {
+                result.overruns++;
+            } else {
+                pending = true;
+            }
+
+            // Next release, with a random jitter
+            release_ns += (uint64_t) message.period_us * 1000;
+            uint64_t jitter_ns = (uint64_t) message.jitter_us * 1000;
+            uint64_t next = release_ns + (jitter_ns == 0 ? 0 : nextRandom() % (jitter_ns + 1));
+            (void) bus;
+            return next;
+        }
+
+        void transmitted(Bus& bus, const STM32::CAN::msg_t& frame, uint64_t queued_ns, uint64_t now_ns) override {
+            (void) bus; (void) frame;
+            pending = false;
+            uint64_t latency = now_ns - queued_ns;
+            result.sent++;
+            result.total_latency_ns += latency;
+            if(latency > result.max_latency_ns) result.max_latency_ns = latency;
+        }
+
+        ScheduleResult result;
+
+    private:
+        BusLoad::PeriodicMessage message = {};
+        uint8_t index = 0;
+        uint32_t random = 1;
+        uint32_t sequence = 0;
+        uint64_t release_ns = 0;
+        bool pending = false;
+
+        uint32_t nextRandom() {
+            random ^= random << 13;
+            random ^= random >> 17;
+            random ^= random << 5;
+            return random;
+        }
+};
+
+template<size_t N>
+Bus::Statistics simulate(const BusLoad::PeriodicMessage (&schedule)[N], STM32::CAN::Bitrate bitrate,
+                         uint64_t duration_ns, ScheduleResult (&results)[N], float error_rate = 0)
+{
+    static_assert(N <= CAN_VIRTUAL_MAX_NODES, "Increase CAN_VIRTUAL_MAX_NODES");
+    Bus bus(bitrate);
+    bus.setErrorRate(error_rate);
+    ScheduleNode nodes[N];
+    for(size_t i = 0; i < N; i++) {
+        nodes[i] = ScheduleNode(schedule[i], (uint8_t) i, 0x9E3779B9u * (uint32_t) (i + 1));
+        bus.attach(nodes[i]);
+    }
+    bus.run(duration_ns);
+    for(size_t i = 0; i < N; i++) results[i] = nodes[i].result;
+    return bus.statistics();
+}
+
+} // namespace CAN::Virtual
@@ -10,7 +10,7 @@
   #define PROTOCOL_VERSION_MAJOR 0
 #endif
 #ifndef PROTOCOL_VERSION_MINOR
-  #define PROTOCOL_VERSION_MINOR 26
+  #define PROTOCOL_VERSION_MINOR 35
 #endif
 #ifndef PROTOCOL_VERSION
   #define PROTOCOL_VERSION "#" TOSTRING(PROTOCOL_VERSION_MAJOR) "." TOSTRING(PROTOCOL_VERSION_MINOR)
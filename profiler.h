@@ -0,0 +1,257 @@
+// Delft Mercurians
+// 2026-10-19
+
+// Loop time profiler: which part of the loop takes the time
+//
+// Sections of the loop (radio, CAN, IMU, control, ...) are timed with the cycle counter and
+// kept as a count, sum, min, max and a histogram per section, from which percentiles are taken.
+// Section 0 is the whole loop, timed from one endLoop() to the next.
+//
+//     Profiler::LoopProfiler profiler;
+//     uint8_t radio_section = profiler.addSection("radio");
+//     void loop() {
+//         { Profiler::Scope s{profiler, radio_section}; radio.run(); }
+//         ...
+//         profiler.endLoop();
+//     }
+//
+// A section costs two cycle counter reads, a divide and a few adds. Define PROFILER_ENABLED 0
+// to compile all of it out.
+//
+// Histogram buckets are 4 per power of 2 microseconds, so percentiles are within 25%.
+
+#pragma once
+#include <Arduino.h>
+#include <string.h>
+#include "radio/protocols_radio.h"
+
+#ifndef PROFILER_ENABLED
+  #define PROFILER_ENABLED 1
+#endif
+#ifndef PROFILER_MAX_SECTIONS
+  #define PROFILER_MAX_SECTIONS 8   // Including the whole loop
+#endif
+#ifndef PROFILER_BUCKETS
+  #define PROFILER_BUCKETS 48       // Up to 8 ms, longer times are counted in the last bucket
+#endif
+
+namespace Profiler {
+
+// Free running cycle counter, micros() where there is none
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+inline void init() {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+inline uint32_t cycles() { return DWT->CYCCNT; }
+inline uint32_t cyclesPerMicrosecond() { return SystemCoreClock / 1000000; }
+#else
+inline void init() { }
+inline uint32_t cycles() { return micros(); }
+inline uint32_t cyclesPerMicrosecond() { return 1; }
+#endif
+
+// 0 -> 3 us one bucket per us, then 4 buckets per power of 2
+inline constexpr uint8_t bucket(uint32_t us) {
+    if(us < 4) return us;
+    uint8_t e = 31 - __builtin_clz(us);
+    uint32_t b = 4 * (e - 1) + ((us >> (e - 2)) & 3);
+    return b < PROFILER_BUCKETS ? b : PROFILER_BUCKETS - 1;
+}
+
+// First time [us] in a bucket
+inline constexpr uint32_t bucketStart(uint8_t b) {
+    return b < 4 ? b : (uint32_t) (4 + b % 4) << (b / 4 - 1);
+}
+
+struct Summary {
+    uint32_t count;
+    uint32_t min;   // [us]
+    uint32_t avg;   // [us]
+    uint32_t p50;   // [us] Upper bound of the bucket
+    uint32_t p90;
+    uint32_t p99;
+    uint32_t max;   // [us]
+};
+
+// Distribution of durations, in ticks of which there are ticks_per_us in a microsecond
+class Histogram {
+    public:
+        Histogram(uint32_t ticks_per_us = 1) : ticks_per_us{ticks_per_us > 0 ? ticks_per_us : 1} { clear(); }
+
+        void add(uint32_t ticks) {
+            count++;
+            sum += ticks;
+            if(ticks > max) max = ticks;
+            if(ticks < min) min = ticks;
+            buckets[bucket(ticks / ticks_per_us)]++;
+        }
+
+        void clear() {
+            count = 0;
+            sum = 0;
+            min = UINT32_MAX;
+            max = 0;
+            memset(buckets, 0, sizeof(buckets));
+        }
+
+        uint32_t size() const { return count; }
+
+        Summary summary() const {
+            Summary r = {};
+            if(count == 0) return r;
+            r.count = count;
+            r.min = min / ticks_per_us;
+            r.avg = sum / count / ticks_per_us;
+            r.max = max / ticks_per_us;
+            r.p50 = percentile(50);
+            r.p90 = percentile(90);
+            r.p99 = percentile(99);
+            return r;
+        }
+
+    private:
+        uint32_t ticks_per_us;
+        uint32_t count;
+        uint64_t sum;   // [ticks]
+        uint32_t min;   // [ticks]
+        uint32_t max;   // [ticks]
+        uint32_t buckets[PROFILER_BUCKETS];
+
+        uint32_t percentile(uint8_t p) const {
+            uint32_t rank = ((uint64_t) count * p + 99) / 100;     // 1-based rank of the sample
+            uint32_t seen = 0;
+            uint32_t max_us = max / ticks_per_us;
+            for(uint8_t b = 0; b < PROFILER_BUCKETS; b++) {
+                seen += buckets[b];
+                if(seen < rank) continue;
+                // The max is exact, and the last bucket has no upper bound
+                uint32_t upper = b + 1 < PROFILER_BUCKETS ? bucketStart(b + 1) - 1 : UINT32_MAX;
+                return upper < max_us ? upper : max_us;
+            }
+            return max_us;
+        }
+};
+
+inline uint16_t saturate16(uint32_t v) { return v > UINT16_MAX ? UINT16_MAX : (uint16_t) v; }
+
+class LoopProfiler {
+    public:
+        static constexpr uint8_t LOOP = 0;
+        static constexpr uint8_t NO_SECTION = 0xFF;
+
+        LoopProfiler() {
+            init();
+            for(uint8_t i = 0; i < PROFILER_MAX_SECTIONS; i++) sections[i].h = Histogram(cyclesPerMicrosecond());
+            sections[LOOP].name = "loop";
+            num_sections = 1;
+            reset();
+        }
+
+        // Returns the index to time the section with, NO_SECTION if there is no room
+        uint8_t addSection(const char* name) {
+            if(num_sections >= PROFILER_MAX_SECTIONS) return NO_SECTION;
+            sections[num_sections].name = name;
+            sections[num_sections].h.clear();
+            return num_sections++;
+        }
+
+        uint8_t sectionCount() const { return num_sections; }
+        const char* sectionName(uint8_t section) const { return section < num_sections ? sections[section].name : ""; }
+
+        // Time since the previous call is one loop
+        void endLoop() {
+            uint32_t now = cycles();
+            if(loop_started) record(LOOP, now - loop_start);
+            loop_start = now;
+            loop_started = true;
+        }
+
+        void record(uint8_t section, uint32_t duration_cycles) {
+            #if PROFILER_ENABLED
+            if(section < num_sections) sections[section].h.add(duration_cycles);
+            #endif
+        }
+
+        Summary summary(uint8_t section) const {
+            return section < num_sections ? sections[section].h.summary() : Summary{};
+        }
+
+        // Start a new measurement window
+        void reset() {
+            for(uint8_t i = 0; i < num_sections; i++) sections[i].h.clear();
+            loop_started = false;
+            window_start_ms = millis();
+        }
+
+        // Loop times in PrimaryStatusLF
+        void fill(Radio::PrimaryStatusLF& lf) const {
+            Summary r = summary(LOOP);
+            lf.avg_loop_time = saturate16(r.avg / 10);
+            lf.max_loop_time = saturate16(r.max / 10);
+        }
+
+        void fill(Radio::LoopProfile& p, uint8_t section) const {
+            Summary r = summary(section);
+            memset(&p, 0, sizeof(p));
+            p.section = section;
+            p.sections = num_sections;
+            strncpy(p.name, sectionName(section), sizeof(p.name));
+            p.count = r.count;
+            p.window_ms = millis() - window_start_ms;
+            p.min = saturate16(r.min);
+            p.avg = saturate16(r.avg);
+            p.p50 = saturate16(r.p50);
+            p.p90 = saturate16(r.p90);
+            p.p99 = saturate16(r.p99);
+            p.max = saturate16(r.max);
+        }
+
+        // Whole loop [us], kept up to date by publish() to be registered as HG::Variable::LOOP_TIME_*
+        uint32_t loop_avg = 0;
+        uint32_t loop_p99 = 0;
+        uint32_t loop_max = 0;
+
+        void publish() {
+            Summary r = summary(LOOP);
+            loop_avg = r.avg;
+            loop_p99 = r.p99;
+            loop_max = r.max;
+        }
+
+    private:
+        struct Section {
+            const char* name;
+            Histogram h;    // [cycles]
+        };
+
+        Section sections[PROFILER_MAX_SECTIONS];
+        uint8_t num_sections = 0;
+        uint32_t loop_start = 0;
+        bool loop_started = false;
+        uint32_t window_start_ms = 0;
+};
+
+// Times its section from construction until it goes out of scope
+class Scope {
+    public:
+        #if PROFILER_ENABLED
+        Scope(LoopProfiler& profiler, uint8_t section) : profiler{profiler}, section{section}, start{cycles()} { }
+        ~Scope() { profiler.record(section, cycles() - start); }
+        #else
+        Scope(LoopProfiler&, uint8_t) { }
+        #endif
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        #if PROFILER_ENABLED
+        LoopProfiler& profiler;
+        uint8_t section;
+        uint32_t start;
+        #endif
+};
+
+} // namespace Profiler
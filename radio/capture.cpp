@@ -0,0 +1,152 @@
+#include "capture.h"
+#include <string.h>
+
+namespace Capture {
+
+// ---------------WRITER------------------ //
+Writer::Writer(Sink records, Sink index)
+    : sink_records{records}, sink_index{index}
+{
+    memset(&block, 0, sizeof(block));
+}
+
+bool Writer::begin() {
+    FileHeader header = {
+        MAGIC_RECORDS, FORMAT_VERSION,
+        CONST_PROTOCOL_VERSION_MAJOR, CONST_PROTOCOL_VERSION_MINOR,
+        sizeof(Record), CAPTURE_INDEX_STRIDE, 0
+    };
+    if(sink_records((const uint8_t*) &header, sizeof(header)) != sizeof(header)) return false;
+    if(sink_index == nullptr) return true;
+    header.magic = MAGIC_INDEX;
+    header.record_size = sizeof(IndexEntry);
+    return sink_index((const uint8_t*) &header, sizeof(header)) == sizeof(header);
+}
+
+bool Writer::write(uint32_t time, Direction direction, uint8_t radio, Radio::SSL_ID id, const Radio::Message& msg) {
+    // Extend to 64 bits, so multi-hour captures stay ordered
+    time_us += (uint32_t) (time - last_time_us);
+    last_time_us = time;
+
+    Record record;
+    record.time_us = time_us;
+    record.direction = direction;
+    record.radio = radio;
+    record._pad[0] = 0;
+    record._pad[1] = 0;
+    record.mw.id = id;
+    memset(record.mw._pad, 0, sizeof(record.mw._pad));
+    record.mw.msg = msg;
+
+    if(sink_records((const uint8_t*) &record, sizeof(record)) != sizeof(record)) {
+        dropped++;
+        return false;
+    }
+
+    if(record_count % CAPTURE_INDEX_STRIDE == 0) {
+        block.time_us = time_us;
+        block.first_record = record_count;
+        block.robot_mask = 0;
+    }
+    block.robot_mask |= robotBit(id);
+    record_count++;
+
+    if(record_count % CAPTURE_INDEX_STRIDE == 0) {
+        return writeIndex();
+    }
+    return true;
+}
+
+bool Writer::end() {
+    if(record_count % CAPTURE_INDEX_STRIDE == 0) return true;    // Block already written
+    return writeIndex();
+}
+
+bool Writer::writeIndex() {
+    if(sink_index == nullptr) return true;
+    return sink_index((const uint8_t*) &block, sizeof(block)) == sizeof(block);
+}
+
+
+// ---------------READER------------------ //
+Reader::Reader(const uint8_t* records, size_t records_len, const uint8_t* index, size_t index_len) {
+    if(records == nullptr || records_len < sizeof(FileHeader)) return;
+    const FileHeader* header = (const FileHeader*) records;
+    if(header->magic != MAGIC_RECORDS || header->format_version != FORMAT_VERSION) return;
+    if(header->record_size != sizeof(Record) || header->index_stride == 0) return;
+    // Messages are stored as they were sent, so a capture of another major version cannot be read.
+    // A newer minor version may contain messages this build does not know
+    if(header->protocols_major != CONST_PROTOCOL_VERSION_MAJOR || header->protocols_minor > CONST_PROTOCOL_VERSION_MINOR) return;
+
+    this->records = (const Record*) (records + sizeof(FileHeader));
+    this->record_count = (records_len - sizeof(FileHeader)) / sizeof(Record);  // Ignores a partially written last record
+    this->index_stride = header->index_stride;
+
+    if(index == nullptr || index_len < sizeof(FileHeader)) return;
+    header = (const FileHeader*) index;
+    const FileHeader* records_header = (const FileHeader*) records;
+    if(header->magic != MAGIC_INDEX || header->index_stride != this->index_stride) return;
+    if(header->protocols_major != records_header->protocols_major || header->protocols_minor != records_header->protocols_minor) return;
+
+    this->index = (const IndexEntry*) (index + sizeof(FileHeader));
+    this->index_count = (index_len - sizeof(FileHeader)) / sizeof(IndexEntry);
+}
+
+uint32_t Reader::seekTime(uint64_t time_us) const {
+    // Records are ordered by time, so a binary search suffices
+    uint32_t lo = 0;
+    uint32_t hi = record_count;
+    while(lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if(records[mid].time_us < time_us) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+const IndexEntry* Reader::findBlock(uint32_t first_record) const {
+    // Entry b is for block b, unless index writes failed: then search, entries are ordered
+    uint32_t b = first_record / index_stride;
+    if(b < index_count && index[b].first_record == first_record) return &index[b];
+    uint32_t lo = 0;
+    uint32_t hi = b < index_count ? b : index_count;
+    while(lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if(index[mid].first_record < first_record) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < index_count && index[lo].first_record == first_record ? &index[lo] : nullptr;
+}
+
+uint32_t Reader::seekRobot(uint32_t from, Radio::SSL_ID id) const {
+    uint32_t bit = robotBit(id);
+    uint32_t i = from;
+    while(i < record_count) {
+        // Skip blocks without any records of this robot, blocks without an entry are searched
+        uint32_t first = i - i % index_stride;
+        const IndexEntry* block = index_count > 0 ? findBlock(first) : nullptr;
+        if(block != nullptr && !(block->robot_mask & bit)) {
+            i = first + index_stride;
+            continue;
+        }
+        uint32_t end = first + index_stride < record_count ? first + index_stride : record_count;
+        for(; i < end; i++) {
+            if(records[i].mw.id == id) return i;
+        }
+    }
+    return record_count;
+}
+
+uint32_t Reader::replayReceived(uint32_t from, uint32_t to, void (*fun)(Radio::Message, Radio::SSL_ID)) const {
+    return replay(from, to, [fun](const Record& r) {
+        if(r.direction == Direction::RX) fun(r.mw.msg, r.mw.id);
+    });
+}
+
+} // namespace Capture
@@ -0,0 +1,143 @@
+// Delft Mercurians
+// 2026-10-19
+
+// Binary capture of radio traffic, for reproducing field issues off-line
+//
+// A capture consists of two append-only files:
+//  Records: FileHeader followed by fixed size Records, ordered by time
+//  Index:   FileHeader followed by one IndexEntry per CAPTURE_INDEX_STRIDE records
+// Both can be memory mapped and handed to Capture::Reader as they are.
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "protocols_radio.h"
+#include "../libversion.h"
+
+namespace Capture {
+
+const uint32_t MAGIC_RECORDS = 0x43524D44;  // "DMRC"
+const uint32_t MAGIC_INDEX = 0x49524D44;    // "DMRI"
+const uint8_t FORMAT_VERSION = 1;
+
+#ifndef CAPTURE_INDEX_STRIDE
+  #define CAPTURE_INDEX_STRIDE 256
+#endif
+
+enum class Direction : uint8_t {
+    RX = 0,     // Received by the base station
+    TX = 1,     // Sent by the base station
+};
+
+// (16 bytes)
+struct FileHeader {
+    uint32_t magic;
+    uint8_t format_version;
+    uint8_t protocols_major;
+    uint8_t protocols_minor;
+    uint8_t record_size;
+    uint32_t index_stride;
+    uint32_t _reserved;
+};
+static_assert(sizeof(FileHeader) == 16);
+
+// (48 bytes)
+struct Record {
+    uint64_t time_us;           // Monotonic capture time [us]
+    Direction direction;
+    uint8_t radio;              // Radio (group) that sent/received the message
+    uint8_t _pad[2];
+    Radio::MessageWrapper mw;   // Robot id and message
+};
+static_assert(sizeof(Record) == 48);
+
+// (16 bytes)
+struct IndexEntry {
+    uint64_t time_us;       // Time of the first record in this block
+    uint32_t first_record;  // Number of the first record in this block
+    uint32_t robot_mask;    // Bit per robot id with records in this block (bit 31: ids >= 31)
+};
+static_assert(sizeof(IndexEntry) == 16);
+
+inline constexpr uint32_t robotBit(Radio::SSL_ID id) {
+    return 1UL << (id < 31 ? id : 31);
+}
+
+// Appends records through user supplied sinks (file, serial port, ...)
+class Writer {
+    public:
+        // Should write all bytes, returns the number of bytes written
+        typedef size_t (*Sink)(const uint8_t* data, size_t len);
+
+        Writer(Sink records, Sink index = nullptr);
+
+        // Write the file headers, call once before the first record
+        bool begin();
+
+        // Append a message, time_us may wrap around (e.g. micros())
+        bool write(uint32_t time_us, Direction direction, uint8_t radio, Radio::SSL_ID id, const Radio::Message& msg);
+
+        // Write the index entry of the unfinished block, call before closing the files
+        bool end();
+
+        uint32_t recordCount() const { return record_count; }
+        uint32_t droppedCount() const { return dropped; }
+
+    private:
+        Sink sink_records;
+        Sink sink_index;
+
+        uint64_t time_us = 0;
+        uint32_t last_time_us = 0;
+
+        uint32_t record_count = 0;
+        uint32_t dropped = 0;
+
+        IndexEntry block;
+        bool writeIndex();
+};
+
+// Read access to a (memory mapped) capture
+class Reader {
+    public:
+        // index may be nullptr, seeking by robot then has to visit every record
+        Reader(const uint8_t* records, size_t records_len, const uint8_t* index = nullptr, size_t index_len = 0);
+
+        // False if the header is wrong or the capture is of an incompatible protocol version
+        bool valid() const { return records != nullptr; }
+        uint32_t count() const { return record_count; }
+        const Record& operator[](uint32_t i) const { return records[i]; }
+
+        // Number of the first record at or after time_us, count() if there is none
+        uint32_t seekTime(uint64_t time_us) const;
+
+        // Number of the first record at or after from for robot id, count() if there is none.
+        // Index entries are matched on first_record, so a block whose entry was lost is searched
+        uint32_t seekRobot(uint32_t from, Radio::SSL_ID id) const;
+
+        // Feed records [from, to) to handler as fast as possible, returns the number of records fed
+        template<typename Handler>
+        uint32_t replay(uint32_t from, uint32_t to, Handler handler) const {
+            if(to > record_count) to = record_count;
+            for(uint32_t i = from; i < to; i++) {
+                handler(records[i]);
+            }
+            return to > from ? to - from : 0;
+        }
+
+        // Feed received messages in [from, to) to a base station style consumer
+        uint32_t replayReceived(uint32_t from, uint32_t to, void (*fun)(Radio::Message, Radio::SSL_ID)) const;
+
+    private:
+        const Record* records = nullptr;
+        uint32_t record_count = 0;
+
+        const IndexEntry* index = nullptr;
+        uint32_t index_count = 0;
+        uint32_t index_stride = CAPTURE_INDEX_STRIDE;
+
+        // Index entry of the block starting at first_record, nullptr if it was not written
+        const IndexEntry* findBlock(uint32_t first_record) const;
+};
+
+} // namespace Capture
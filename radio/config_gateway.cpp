@@ -0,0 +1,169 @@
+#include "config_gateway.h"
+#include <string.h>
+
+namespace Radio {
+
+const ConfigGateway::Range ConfigGateway::DEFAULT_RANGES[2] = {
+    ConfigGateway::TRACTION,
+    ConfigGateway::DRIBBLER,
+};
+
+ConfigGateway::ConfigGateway(CanSend send, Reply reply, uint32_t timeout_ms, uint8_t retries)
+    : fun_send{send}, fun_reply{reply}, timeout_ms{timeout_ms}, max_retries{retries}
+{
+    memset(transactions, 0, sizeof(transactions));
+    memset(requests, 0, sizeof(requests));
+}
+
+void ConfigGateway::setRanges(const Range* ranges, uint8_t num_ranges) {
+    this->ranges = ranges;
+    this->num_ranges = num_ranges;
+}
+
+const ConfigGateway::Range* ConfigGateway::findRange(HG::Variable var) const {
+    for(uint8_t i = 0; i < num_ranges; i++) {
+        uint8_t offset = (uint8_t) var - (uint8_t) ranges[i].first;
+        CAN::VARIABLE v = CAN::VARIABLE::MASK;
+        if(offset < RANGE_SIZE && canVariable(offset, v)) return &ranges[i];
+    }
+    return nullptr;
+}
+
+bool ConfigGateway::forwards(HG::Variable var) const {
+    return findRange(var) != nullptr;
+}
+
+bool ConfigGateway::submit(const Radio::MultiConfigMessage& reply, uint8_t forward_mask, uint32_t now_ms) {
+    bool write;
+    switch(reply.operation) {
+        case HG::ConfigOperation::READ_RETURN:
+            write = false;
+            break;
+        case HG::ConfigOperation::WRITE_RETURN:
+            write = true;
+            break;
+        default:
+            return false;   // The drivers have no defaults to go back to
+    }
+
+    // Count what is needed before touching anything
+    uint8_t needed = 0;
+    for(uint8_t i = 0; i < 5; i++) {
+        if(!(forward_mask & (1 << i))) continue;
+        const Range* range = findRange(reply.vars[i]);
+        if(range == nullptr) return false;
+        for(uint8_t d = 0; d < CAN_NUM_DEVICE_IDS; d++) {
+            if(!(range->devices & (1 << d))) continue;
+            needed++;
+            if(!write) break;   // Read from the lowest device only
+        }
+    }
+    uint8_t t = CONFIG_GATEWAY_MAX_TRANSACTIONS;
+    for(uint8_t i = 0; i < CONFIG_GATEWAY_MAX_TRANSACTIONS; i++) {
+        if(!transactions[i].used) {
+            t = i;
+            break;
+        }
+    }
+    uint8_t free = 0;
+    for(uint8_t i = 0; i < CONFIG_GATEWAY_MAX_REQUESTS; i++) {
+        if(!requests[i].used) free++;
+    }
+    if(t == CONFIG_GATEWAY_MAX_TRANSACTIONS || free < needed) return false;
+
+    Transaction& tr = transactions[t];
+    tr.reply = reply;
+    tr.pending = needed;
+    tr.used = true;
+
+    uint8_t r = 0;
+    for(uint8_t i = 0; i < 5; i++) {
+        if(!(forward_mask & (1 << i))) continue;
+        const Range* range = findRange(reply.vars[i]);
+        CAN::VARIABLE variable = CAN::VARIABLE::MASK;
+        canVariable((uint8_t) reply.vars[i] - (uint8_t) range->first, variable);
+        for(uint8_t d = 0; d < CAN_NUM_DEVICE_IDS; d++) {
+            if(!(range->devices & (1 << d))) continue;
+            while(requests[r].used) r++;
+            requests[r] = Request{reply.values[i], now_ms, variable, (CAN::DEVICE_ID) d, t, i, 0, write, false, true};
+            if(!write) break;
+        }
+    }
+
+    if(needed == 0) {
+        tr.used = false;
+        fun_reply(tr.reply);
+        return true;
+    }
+    poll(now_ms);
+    return true;
+}
+
+bool ConfigGateway::sendRequest(Request& r, uint32_t now_ms) {
+    CAN_VARIABLE_TYPE value;
+    memcpy(&value, &r.value, sizeof(value));
+    STM32::CAN::msg_t frame;
+    CAN::encodeVariable(frame, r.device, r.variable, r.write ? CAN::ACCESS::WRITE : CAN::ACCESS::READ, value);
+    if(!fun_send(frame)) return false;
+    r.sent_ms = now_ms;
+    r.tries++;
+    if(!r.in_flight) in_flight++;
+    r.in_flight = true;
+    return true;
+}
+
+bool ConfigGateway::handle(const STM32::CAN::msg_t& frame, uint32_t now_ms) {
+    CAN::MESSAGE_ID message = CAN::getMessageId(frame.id);
+    if(CAN::getAccess(message) != CAN::ACCESS::MASK) return false;
+    CAN::Value_Return ret;
+    if(!CAN::decode(frame, ret)) return false;
+
+    CAN::VARIABLE variable = CAN::getVariable(message);
+    for(uint8_t i = 0; i < CONFIG_GATEWAY_MAX_REQUESTS; i++) {
+        Request& r = requests[i];
+        if(!r.used || !r.in_flight || r.device != ret.txId || r.variable != variable) continue;
+        uint32_t value;
+        memcpy(&value, &ret.value, sizeof(value));
+        finish(r, true, value);
+        poll(now_ms);
+        return true;
+    }
+    return false;
+}
+
+void ConfigGateway::poll(uint32_t now_ms) {
+    for(uint8_t i = 0; i < CONFIG_GATEWAY_MAX_REQUESTS; i++) {
+        Request& r = requests[i];
+        if(!r.used) continue;
+        if(r.in_flight) {
+            if(now_ms - r.sent_ms < timeout_ms) continue;
+            if(r.tries > max_retries) {
+                finish(r, false, 0);
+                continue;
+            }
+            sendRequest(r, now_ms);     // Retry, stays in flight
+        } else if(in_flight < CONFIG_GATEWAY_MAX_IN_FLIGHT) {
+            if(!sendRequest(r, now_ms)) return;    // No mailbox free, try again next time
+        }
+    }
+}
+
+void ConfigGateway::finish(Request& r, bool ok, uint32_t value) {
+    Transaction& tr = transactions[r.transaction];
+    if(!ok) {
+        tr.reply.vars[r.index] = HG::Variable::NONE;
+    } else if(!r.write || tr.reply.values[r.index] == r.value) {
+        // Reads have one request, writes report the value of the first driver that answers
+        tr.reply.values[r.index] = value;
+    }
+    if(r.in_flight) in_flight--;
+    r.used = false;
+    r.in_flight = false;
+
+    if(--tr.pending == 0) {
+        tr.used = false;
+        fun_reply(tr.reply);
+    }
+}
+
+} // namespace Radio
@@ -0,0 +1,125 @@
+// Delft Mercurians
+// 2026-10-19
+
+// Forwards radio configuration accesses of motor driver variables (HG::Variable::MD_*) to the
+// motor drivers over CAN, with several CAN requests in flight at once.
+//
+// The robot fills in what it can of a MultiConfigMessage itself and submits the rest here.
+// The reply is sent once all CAN replies are in, failed or timed out variables are
+// returned as HG::Variable::NONE, like unavailable variables are.
+
+#pragma once
+#include "protocols_radio.h"
+#include "../can/can_codec.h"
+
+#ifndef CONFIG_GATEWAY_MAX_TRANSACTIONS
+  #define CONFIG_GATEWAY_MAX_TRANSACTIONS 4
+#endif
+#ifndef CONFIG_GATEWAY_MAX_REQUESTS
+  #define CONFIG_GATEWAY_MAX_REQUESTS 24
+#endif
+#ifndef CONFIG_GATEWAY_MAX_IN_FLIGHT
+  #define CONFIG_GATEWAY_MAX_IN_FLIGHT 8
+#endif
+
+namespace Radio {
+
+inline constexpr uint8_t deviceBit(CAN::DEVICE_ID device) {
+    return 1 << (uint8_t) device;
+}
+
+class ConfigGateway {
+    public:
+        typedef bool (*CanSend)(const STM32::CAN::msg_t& frame);   // false if the frame could not be queued
+        typedef void (*Reply)(Radio::MultiConfigMessage reply);
+
+        // A block of HG::Variables laid out like the MD_TRACTION_* block, mapped onto a set of drivers
+        struct Range {
+            HG::Variable first;
+            uint8_t devices;    // Bit per CAN::DEVICE_ID, writes go to all of them, reads to the lowest
+        };
+
+        static constexpr uint8_t RANGE_SIZE = 0x20;
+
+        static constexpr Range TRACTION = {
+            HG::Variable::MD_TRACTION_LIM_C,
+            deviceBit(CAN::DEVICE_ID::DRIVER_0) | deviceBit(CAN::DEVICE_ID::DRIVER_1)
+                | deviceBit(CAN::DEVICE_ID::DRIVER_2) | deviceBit(CAN::DEVICE_ID::DRIVER_3)
+        };
+        static constexpr Range DRIBBLER = {
+            HG::Variable::MD_DRIBBLER_LIM_C,
+            deviceBit(CAN::DEVICE_ID::DRIVER_A)
+        };
+
+        // CAN variable at an offset in a range, false for reserved offsets
+        static constexpr bool canVariable(uint8_t offset, CAN::VARIABLE& variable) {
+            constexpr CAN::VARIABLE limits[] = {CAN::VARIABLE::LIM_C, CAN::VARIABLE::LIM_U, CAN::VARIABLE::LIM_V};
+            constexpr CAN::VARIABLE pids[] = {CAN::VARIABLE::PID_CD_P, CAN::VARIABLE::PID_CQ_P, CAN::VARIABLE::PID_V_P, CAN::VARIABLE::PID_A_P};
+            if(offset < 3) {
+                variable = limits[offset];
+                return true;
+            }
+            if(offset < 3 + 4 * 6) {
+                variable = (CAN::VARIABLE) ((uint8_t) pids[(offset - 3) / 6] + (offset - 3) % 6);
+                return true;
+            }
+            return false;
+        }
+
+        ConfigGateway(CanSend send, Reply reply, uint32_t timeout_ms = 20, uint8_t retries = 2);
+
+        // Ranges that are forwarded (TRACTION and DRIBBLER by default), ranges must stay valid
+        void setRanges(const Range* ranges, uint8_t num_ranges);
+
+        // Whether a variable is forwarded to the motor drivers
+        bool forwards(HG::Variable var) const;
+
+        // Forward the variables of a READ/WRITE reply that are marked in forward_mask (bit per index)
+        // Returns false if there is no room, nothing is forwarded then
+        bool submit(const Radio::MultiConfigMessage& reply, uint8_t forward_mask, uint32_t now_ms);
+
+        // Value_Return frames from the drivers, returns true if the frame was a reply to a request
+        bool handle(const STM32::CAN::msg_t& frame, uint32_t now_ms);
+
+        // Send queued requests and handle timeouts, call from the loop
+        void poll(uint32_t now_ms);
+
+    private:
+        struct Transaction {
+            Radio::MultiConfigMessage reply;
+            uint8_t pending;    // Requests still outstanding
+            bool used;
+        };
+
+        struct Request {
+            uint32_t value;
+            uint32_t sent_ms;
+            CAN::VARIABLE variable;
+            CAN::DEVICE_ID device;
+            uint8_t transaction;
+            uint8_t index;      // Index in the MultiConfigMessage
+            uint8_t tries;
+            bool write;
+            bool in_flight;
+            bool used;
+        };
+
+        CanSend fun_send;
+        Reply fun_reply;
+        uint32_t timeout_ms;
+        uint8_t max_retries;
+
+        static const Range DEFAULT_RANGES[2];
+        const Range* ranges = DEFAULT_RANGES;
+        uint8_t num_ranges = 2;
+
+        Transaction transactions[CONFIG_GATEWAY_MAX_TRANSACTIONS];
+        Request requests[CONFIG_GATEWAY_MAX_REQUESTS];
+        uint8_t in_flight = 0;
+
+        const Range* findRange(HG::Variable var) const;
+        bool sendRequest(Request& r, uint32_t now_ms);
+        void finish(Request& r, bool ok, uint32_t value);
+};
+
+} // namespace Radio
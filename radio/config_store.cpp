@@ -0,0 +1,122 @@
+#include "config_store.h"
+#include <string.h>
+
+namespace Radio {
+
+uint16_t ConfigStore::crc(const uint8_t* data, uint8_t len) {
+    uint16_t c = 0xFFFF;
+    for(uint8_t i = 0; i < len; i++) {
+        c ^= (uint16_t) data[i] << 8;
+        for(uint8_t b = 0; b < 8; b++) c = (c & 0x8000) ? (c << 1) ^ 0x1021 : c << 1;
+    }
+    return c;
+}
+
+ConfigStore::Record ConfigStore::makeRecord(HG::Variable var, uint32_t value, uint8_t flags) {
+    Record r = {value, var, flags, 0};
+    r.crc = crc((const uint8_t*) &r, offsetof(Record, crc));
+    return r;
+}
+
+static bool erased(const ConfigStore::Record& r) {
+    const uint8_t* b = (const uint8_t*) &r;
+    for(uint8_t i = 0; i < sizeof(r); i++) if(b[i] != 0xFF) return false;
+    return true;
+}
+
+bool ConfigStore::readHeader(uint8_t s, Header& header) const {
+    flash.read(s, 0, (uint8_t*) &header, sizeof(header));
+    return header.magic == MAGIC && header.generation != 0xFFFFFFFF;
+}
+
+bool ConfigStore::begin() {
+    memset(values, 0, sizeof(values));
+    memset(has, 0, sizeof(has));
+
+    Header h0, h1;
+    bool valid0 = readHeader(0, h0);
+    bool valid1 = readHeader(1, h1);
+    if(!valid0 && !valid1) {
+        // Nothing stored yet
+        Header h = {MAGIC, 1};
+        if(!flash.erase(0) || !flash.program(0, 0, (const uint8_t*) &h, sizeof(h))) return false;
+        sector = 0;
+        generation = 1;
+        write_offset = sizeof(Header);
+        return true;
+    }
+    sector = valid0 && (!valid1 || h0.generation > h1.generation) ? 0 : 1;
+    generation = sector == 0 ? h0.generation : h1.generation;
+
+    // One pass: the latest record of every variable wins, the log ends at the first erased record
+    write_offset = sizeof(Header);
+    while(write_offset + sizeof(Record) <= flash.sectorSize()) {
+        Record r;
+        flash.read(sector, write_offset, (uint8_t*) &r, sizeof(r));
+        if(erased(r)) break;
+        write_offset += sizeof(Record);
+        if(r.crc != crc((const uint8_t*) &r, offsetof(Record, crc))) continue;     // Torn write
+        uint8_t v = (uint8_t) r.var;
+        if(r.flags & RECORD_FORGET) {
+            has[v / 32] &= ~(1UL << (v % 32));
+        } else {
+            values[v] = r.value;
+            has[v / 32] |= 1UL << (v % 32);
+        }
+    }
+    return true;
+}
+
+void ConfigStore::load(Apply apply, void* context) const {
+    for(uint16_t v = 0; v < 256; v++) {
+        if(stored((HG::Variable) v)) apply((HG::Variable) v, values[v], context);
+    }
+}
+
+bool ConfigStore::save(HG::Variable var, uint32_t value) {
+    if(stored(var) && values[(uint8_t) var] == value) return true;
+    if(!append(makeRecord(var, value, 0))) return false;
+    values[(uint8_t) var] = value;
+    has[(uint8_t) var / 32] |= 1UL << ((uint8_t) var % 32);
+    return true;
+}
+
+bool ConfigStore::forget(HG::Variable var) {
+    if(!stored(var)) return true;
+    if(!append(makeRecord(var, 0, RECORD_FORGET))) return false;
+    has[(uint8_t) var / 32] &= ~(1UL << ((uint8_t) var % 32));
+    return true;
+}
+
+bool ConfigStore::append(const Record& r) {
+    if(write_offset + sizeof(Record) > flash.sectorSize() && !compact()) return false;
+    if(write_offset + sizeof(Record) > flash.sectorSize()) return false;    // Every variable stored, and still no room
+    if(!flash.program(sector, write_offset, (const uint8_t*) &r, sizeof(r))) return false;
+    write_offset += sizeof(Record);
+    return true;
+}
+
+bool ConfigStore::compact() {
+    uint8_t other = 1 - sector;
+    if(!flash.erase(other)) return false;
+
+    uint32_t offset = sizeof(Header);
+    for(uint16_t v = 0; v < 256; v++) {
+        if(!stored((HG::Variable) v)) continue;
+        if(offset + sizeof(Record) > flash.sectorSize()) return false;
+        Record r = makeRecord((HG::Variable) v, values[v], 0);
+        if(!flash.program(other, offset, (const uint8_t*) &r, sizeof(r))) return false;
+        offset += sizeof(Record);
+    }
+
+    // Header last, until then the old sector is the one in use
+    Header h = {MAGIC, generation + 1};
+    if(!flash.program(other, 0, (const uint8_t*) &h, sizeof(h))) return false;
+    sector = other;
+    generation++;
+    write_offset = offset;
+    compactions++;
+    return true;
+}
+
+} // namespace Radio
@@ -0,0 +1,92 @@
+// Delft Mercurians
+// 2026-10-19
+
+// Configuration variables kept in flash, so tuning survives a reboot
+//
+// Values are appended as 8 byte records to a log in one of two flash sectors. The latest
+// record of a variable wins, so loading is one pass over the log. When the sector is full, the
+// latest values are written to the other sector (compaction) and the sector header is written
+// last, so a power loss during compaction leaves the old sector in use. Each sector is erased
+// once per compaction, the two take turns.
+//
+// Records have a CRC, a record that was torn by a power loss is skipped.
+//
+// The flash itself is behind the Flash interface, the firmware implements it for its MCU.
+// Programming is done in 8 byte double words, which STM32 flash needs.
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "../utils.h"
+
+namespace Radio {
+
+class Flash {
+    public:
+        virtual uint32_t sectorSize() const = 0;
+        virtual bool erase(uint8_t sector) = 0;                 // Sector 0 or 1, to all 0xFF
+        virtual bool program(uint8_t sector, uint32_t offset, const uint8_t* data, uint32_t len) = 0;  // 8 byte aligned
+        virtual void read(uint8_t sector, uint32_t offset, uint8_t* data, uint32_t len) = 0;
+};
+
+class ConfigStore {
+    public:
+        typedef void (*Apply)(HG::Variable var, uint32_t value, void* context);
+
+        struct Record {
+            uint32_t value;
+            HG::Variable var;
+            uint8_t flags;      // RECORD_*
+            uint16_t crc;       // CRC-16/CCITT of the bytes before it
+        };
+        static_assert(sizeof(Record) == 8);
+
+        static constexpr uint8_t RECORD_FORGET = 1 << 0;    // Back to the default, value is not used
+        static constexpr uint32_t MAGIC = 0x46434748;       // "HGCF"
+
+        ConfigStore(Flash& flash) : flash{flash} { }
+
+        // Find the sector in use (formats one if there is none), call before anything else
+        bool begin();
+
+        // Call apply with the latest value of every stored variable
+        void load(Apply apply, void* context = nullptr) const;
+
+        // Append a value, does nothing if it is already stored
+        bool save(HG::Variable var, uint32_t value);
+
+        // Forget a stored value, so the default is used after a reboot
+        bool forget(HG::Variable var);
+
+        bool stored(HG::Variable var) const { return has[(uint8_t) var / 32] & (1UL << ((uint8_t) var % 32)); }
+        uint32_t value(HG::Variable var) const { return values[(uint8_t) var]; }
+
+        uint32_t compactionCount() const { return compactions; }
+        uint32_t freeRecords() const { return (flash.sectorSize() - write_offset) / sizeof(Record); }
+
+        static uint16_t crc(const uint8_t* data, uint8_t len);
+
+    private:
+        struct Header {
+            uint32_t magic;
+            uint32_t generation;    // The sector with the highest generation is in use
+        };
+        static_assert(sizeof(Header) == 8);
+
+        Flash& flash;
+        uint8_t sector = 0;
+        uint32_t generation = 0;
+        uint32_t write_offset = 0;
+        uint32_t compactions = 0;
+
+        // Latest value of every variable, to skip unchanged saves and for compaction
+        uint32_t values[256];
+        uint32_t has[256 / 32];
+
+        bool readHeader(uint8_t s, Header& header) const;
+        bool append(const Record& r);
+        bool compact();
+        static Record makeRecord(HG::Variable var, uint32_t value, uint8_t flags);
+};
+
+} // namespace Radio
@@ -0,0 +1,129 @@
+#include "config_transactions.h"
+#include <string.h>
+
+namespace Radio {
+
+static bool isReplyTo(HG::ConfigOperation reply, HG::ConfigOperation request) {
+    switch(request) {
+        case HG::ConfigOperation::READ: return reply == HG::ConfigOperation::READ_RETURN;
+        case HG::ConfigOperation::WRITE: return reply == HG::ConfigOperation::WRITE_RETURN;
+        case HG::ConfigOperation::SET_DEFAULT: return reply == HG::ConfigOperation::SET_DEFAULT_RETURN;
+        default: return false;
+    }
+}
+
+ConfigTransactions::ConfigTransactions(Done done, uint32_t timeout_ms, uint8_t max_retries)
+    : done{done}, timeout_ms{timeout_ms}, max_retries{max_retries}
+{
+    memset(robots, 0, sizeof(robots));
+    for(Robot& r : robots) r.next_id = 1;
+}
+
+bool ConfigTransactions::submit(Radio::SSL_ID robot, Radio::MultiConfigMessage request) {
+    if(robot >= CONFIG_TRANSACTIONS_MAX_ROBOTS) return false;
+    Robot& r = robots[robot];
+    if(r.count >= CONFIG_TRANSACTIONS_QUEUE) return false;
+
+    request.request_id = r.next_id;
+    r.next_id = r.next_id == UINT8_MAX ? 1 : r.next_id + 1;    // 0 is not tracked
+    r.queue[(r.first + r.count) % CONFIG_TRANSACTIONS_QUEUE] = Transaction{request, 0, 0, State::QUEUED};
+    r.count++;
+    return true;
+}
+
+bool ConfigTransactions::handle(Radio::SSL_ID robot, const Radio::MultiConfigMessage& reply) {
+    if(robot >= CONFIG_TRANSACTIONS_MAX_ROBOTS || reply.request_id == 0) return false;
+    Robot& r = robots[robot];
+    for(uint8_t i = 0; i < r.count; i++) {
+        Transaction& t = r.queue[(r.first + i) % CONFIG_TRANSACTIONS_QUEUE];
+        if(t.state != State::SENT || t.request.request_id != reply.request_id) continue;
+        if(!isReplyTo(reply.operation, t.request.operation)) return false;
+        finish(r, t);
+        if(done != nullptr) done(robot, reply, true);
+        return true;
+    }
+    return false;   // Reply to a retransmit that was already answered
+}
+
+bool ConfigTransactions::takeRequest(Radio::SSL_ID& robot, Radio::MultiConfigMessage& request, uint32_t now_ms) {
+    for(uint8_t i = 0; i < CONFIG_TRANSACTIONS_MAX_ROBOTS; i++) {
+        uint8_t id = (next_robot + i) % CONFIG_TRANSACTIONS_MAX_ROBOTS;
+        if(robots[id].count == 0 || !takeRequest(robots[id], request, now_ms)) continue;
+        robot = id;
+        next_robot = id + 1;
+        return true;
+    }
+    return false;
+}
+
+bool ConfigTransactions::takeRequest(Robot& r, Radio::MultiConfigMessage& request, uint32_t now_ms) {
+    // Retransmits first, they hold up the window
+    uint8_t in_flight = 0;
+    for(uint8_t i = 0; i < r.count; i++) {
+        Transaction& t = r.queue[(r.first + i) % CONFIG_TRANSACTIONS_QUEUE];
+        if(t.state != State::SENT) continue;
+        in_flight++;
+        if(now_ms - t.sent_ms < timeout_ms) continue;
+        if(t.tries > max_retries) {
+            Radio::SSL_ID robot = &r - robots;
+            Radio::MultiConfigMessage given_up = t.request;
+            finish(r, t);
+            if(done != nullptr) done(robot, given_up, false);
+            return takeRequest(r, request, now_ms);
+        }
+        t.sent_ms = now_ms;
+        t.tries++;
+        retransmits++;
+        request = t.request;
+        return true;
+    }
+
+    if(in_flight >= CONFIG_TRANSACTIONS_WINDOW) return false;
+    for(uint8_t i = 0; i < r.count; i++) {
+        uint8_t index = (r.first + i) % CONFIG_TRANSACTIONS_QUEUE;
+        Transaction& t = r.queue[index];
+        if(t.state != State::QUEUED || conflicts(r, i)) continue;
+        t.state = State::SENT;
+        t.sent_ms = now_ms;
+        t.tries = 1;
+        request = t.request;
+        return true;
+    }
+    return false;
+}
+
+// Whether the request at position n shares a variable with an unfinished one before it
+bool ConfigTransactions::conflicts(const Robot& r, uint8_t n) const {
+    const Radio::MultiConfigMessage& m = r.queue[(r.first + n) % CONFIG_TRANSACTIONS_QUEUE].request;
+    for(uint8_t i = 0; i < n; i++) {
+        const Transaction& t = r.queue[(r.first + i) % CONFIG_TRANSACTIONS_QUEUE];
+        if(t.state == State::FREE) continue;
+        for(uint8_t a = 0; a < 5; a++) {
+            if(m.vars[a] == HG::Variable::NONE) continue;
+            for(uint8_t b = 0; b < 5; b++) {
+                if(m.vars[a] == t.request.vars[b]) return true;
+            }
+        }
+    }
+    return false;
+}
+
+void ConfigTransactions::finish(Robot& r, Transaction& t) {
+    t.state = State::FREE;
+    while(r.count > 0 && r.queue[r.first].state == State::FREE) {
+        r.first = (r.first + 1) % CONFIG_TRANSACTIONS_QUEUE;
+        r.count--;
+    }
+}
+
+uint8_t ConfigTransactions::pending(Radio::SSL_ID robot) const {
+    if(robot >= CONFIG_TRANSACTIONS_MAX_ROBOTS) return 0;
+    const Robot& r = robots[robot];
+    uint8_t n = 0;
+    for(uint8_t i = 0; i < r.count; i++) {
+        if(r.queue[(r.first + i) % CONFIG_TRANSACTIONS_QUEUE].state != State::FREE) n++;
+    }
+    return n;
+}
+
+} // namespace Radio
@@ -0,0 +1,82 @@
+// Delft Mercurians
+// 2026-10-19
+
+// Configuration requests from the base station with a request ID, a window and retransmits
+//
+// Requests are queued per robot and sent from CustomRF24_Base::run(), up to
+// CONFIG_TRANSACTIONS_WINDOW per robot at once. Replies are matched on request_id, requests
+// without a reply in time are sent again, and given up after max_retries. The robot answers a
+// retransmitted WRITE/SET_DEFAULT from its reply cache, so it is applied once. The cache only
+// keeps entries for RADIO_CONFIG_REPLY_AGE_MS, so keep timeout_ms * (max_retries + 1) below that.
+//
+// A request that touches a variable of an earlier unfinished request waits for it, so writes
+// to the same variable can't overtake each other.
+
+#pragma once
+#include "protocols_radio.h"
+
+#ifndef CONFIG_TRANSACTIONS_QUEUE
+  #define CONFIG_TRANSACTIONS_QUEUE 8     // Requests per robot, sent or waiting
+#endif
+#ifndef CONFIG_TRANSACTIONS_WINDOW
+  #define CONFIG_TRANSACTIONS_WINDOW 4    // Requests per robot without a reply yet, at most RADIO_CONFIG_REPLY_CACHE
+#endif
+#ifndef CONFIG_TRANSACTIONS_MAX_ROBOTS
+  #define CONFIG_TRANSACTIONS_MAX_ROBOTS 16
+#endif
+
+namespace Radio {
+
+class ConfigTransactions {
+    public:
+        // reply is the request itself if it was given up on (ok is false then)
+        typedef void (*Done)(Radio::SSL_ID robot, const Radio::MultiConfigMessage& reply, bool ok);
+
+        ConfigTransactions(Done done, uint32_t timeout_ms = 30, uint8_t max_retries = 5);
+
+        // Queue a request, its request_id is filled in. Returns false if the queue of the robot is full
+        bool submit(Radio::SSL_ID robot, Radio::MultiConfigMessage request);
+
+        // MultiConfigMessage from a robot, returns true if it was the reply to a request
+        bool handle(Radio::SSL_ID robot, const Radio::MultiConfigMessage& reply);
+
+        // Next request to send, new or retransmitted, false if there is none
+        bool takeRequest(Radio::SSL_ID& robot, Radio::MultiConfigMessage& request, uint32_t now_ms);
+
+        uint8_t pending(Radio::SSL_ID robot) const;     // Requests not finished yet
+        uint32_t retransmitCount() const { return retransmits; }
+
+    private:
+        enum class State : uint8_t {
+            FREE,
+            QUEUED,
+            SENT,
+        };
+
+        struct Transaction {
+            Radio::MultiConfigMessage request;
+            uint32_t sent_ms;
+            uint8_t tries;
+            State state;
+        };
+
+        struct Robot {
+            Transaction queue[CONFIG_TRANSACTIONS_QUEUE];   // Ring in submit order
+            uint8_t first;      // Oldest unfinished
+            uint8_t count;      // From first, including finished ones behind it
+            uint8_t next_id;
+        };
+
+        Done done;
+        uint32_t timeout_ms;
+        uint8_t max_retries;
+        uint32_t retransmits = 0;
+        Robot robots[CONFIG_TRANSACTIONS_MAX_ROBOTS];
+        uint8_t next_robot = 0;     // Round robin
+
+        bool takeRequest(Robot& r, Radio::MultiConfigMessage& request, uint32_t now_ms);
+        bool conflicts(const Robot& r, uint8_t index) const;
+        void finish(Robot& r, Transaction& t);
+};
+
+} // namespace Radio
@@ -0,0 +1,72 @@
+// Delft Mercurians
+// 2026-10-19
+
+// Flash in RAM, optionally kept in a file, to run ConfigStore on a PC
+//
+// Behaves like NOR flash: erasing sets a sector to 0xFF, programming can only clear bits and
+// must be 8 byte aligned. Counts erases and programmed bytes, to check wear.
+
+#pragma once
+#include <stdio.h>
+#include <string.h>
+#include "config_store.h"
+
+#ifndef FLASH_EMULATOR_SECTOR_SIZE
+  #define FLASH_EMULATOR_SECTOR_SIZE 2048
+#endif
+
+namespace Radio {
+
+class FlashEmulator : public Flash {
+    public:
+        // path: file the contents are loaded from and written to, nullptr to keep them in RAM only
+        FlashEmulator(const char* path = nullptr) : path{path} {
+            memset(data, 0xFF, sizeof(data));
+            if(path == nullptr) return;
+            FILE* f = fopen(path, "rb");
+            if(f == nullptr) return;
+            if(fread(data, 1, sizeof(data), f) != sizeof(data)) memset(data, 0xFF, sizeof(data));
+            fclose(f);
+        }
+
+        uint32_t sectorSize() const override { return FLASH_EMULATOR_SECTOR_SIZE; }
+
+        bool erase(uint8_t sector) override {
+            if(sector > 1) return false;
+            memset(data[sector], 0xFF, FLASH_EMULATOR_SECTOR_SIZE);
+            erases[sector]++;
+            return store();
+        }
+
+        bool program(uint8_t sector, uint32_t offset, const uint8_t* bytes, uint32_t len) override {
+            if(sector > 1 || offset % 8 != 0 || len % 8 != 0 || offset + len > FLASH_EMULATOR_SECTOR_SIZE) return false;
+            for(uint32_t i = 0; i < len; i++) data[sector][offset + i] &= bytes[i];     // Only 1 -> 0
+            programmed += len;
+            return store();
+        }
+
+        void read(uint8_t sector, uint32_t offset, uint8_t* bytes, uint32_t len) override {
+            memcpy(bytes, &data[sector][offset], len);
+        }
+
+        uint32_t eraseCount(uint8_t sector) const { return erases[sector]; }
+        uint32_t programmedBytes() const { return programmed; }
+
+        uint8_t data[2][FLASH_EMULATOR_SECTOR_SIZE];
+
+    private:
+        const char* path;
+        uint32_t erases[2] = {0, 0};
+        uint32_t programmed = 0;
+
+        bool store() {
+            if(path == nullptr) return true;
+            FILE* f = fopen(path, "wb");
+            if(f == nullptr) return false;
+            bool ok = fwrite(data, 1, sizeof(data), f) == sizeof(data);
+            fclose(f);
+            return ok;
+        }
+};
+
+} // namespace Radio
@@ -4,7 +4,9 @@
 // thomas.hettasch@gmail.com
 
 #pragma once
+#include <math.h>
 #include "../utils.h"
+#include "../scaling.h"
 #include "../can/protocols_can.h"
 
 namespace Radio {
@@ -26,9 +28,10 @@ struct MultiConfigMessage {
     HG::Variable vars[5];   // Variable/Parameter that is being accessed
 
     HG::ConfigOperation operation;         // Configuration operation
-    HG::VariableType type;  // not used...
+    HG::VariableType type;  // Type of the values, VOID if not given. Checked against variable_meta.h
 
-    uint8_t _pad;
+    uint8_t request_id;     // Echoed in the reply, 0 if not tracked (see config_transactions.h). Was padding,
+                            // tools that don't track requests must send 0 or a repeated write can be taken for a retransmit
 
     uint32_t values[5];     // Value to be written/that is being acknowledged
 };
@@ -40,6 +43,39 @@ enum class Access : uint8_t {
     READWRITE,  // Allow both writing/reading to/from the robot
 };
 
+/* CAPABILITY MESSAGES */
+
+// Optional protocol features, negotiated per robot at association (32 bit bitmap)
+// Note: never reuse bits, old firmware will keep advertising them
+enum class Capability : uint32_t {
+    NONE = 0,
+    TRAJECTORY_COMMAND = 1UL << 0,  // Understands TrajectoryCommand
+    COMMAND_TRACE = 1UL << 1,       // Answers traced commands with a TraceRecord
+};
+
+inline constexpr uint32_t operator|(Capability a, Capability b) {
+    return (uint32_t) a | (uint32_t) b;
+}
+inline constexpr uint32_t operator|(uint32_t a, Capability b) {
+    return a | (uint32_t) b;
+}
+inline constexpr bool hasCapability(uint32_t capabilities, Capability c) {
+    return (capabilities & (uint32_t) c) == (uint32_t) c;
+}
+
+// Capability advertisement (bidirectional, 28 bytes)
+struct Capabilities {
+    HG::Version version;        // Firmware and protocol version of the sender (6 bytes)
+    uint8_t _pad0[2];
+
+    uint32_t capabilities;      // Bitmap of Capability
+
+    bool request;               // Receiver should answer with its own capabilities
+
+    uint8_t _pad[15];
+};
+static_assert(sizeof(Capabilities) == 28);
+
 /* COMMAND MESSAGES */
 
 enum class RobotCommand : uint8_t;
@@ -183,7 +219,9 @@ struct Command {
 
     GenericCommand gen_command;
 
-    uint8_t _pad[8];
+    uint8_t trace_id;               // Answer with a TraceRecord, 0 if not traced
+
+    uint8_t _pad[7];
 };
 static_assert(sizeof(Command) == 28);
 
@@ -199,10 +237,113 @@ struct GlobalCommand {
     uint16_t max_yaw_rate;  // Maximum yaw rate for yaw controller, [1/10 rad/s]
     int8_t preferred_rotation_direction;    // Direction to turn in (+1, 0, -1)
 
-    uint8_t _pad;    // Explicit padding for bindgen (1 bytes)
+    uint8_t trace_id;   // Answer with a TraceRecord, 0 if not traced
 };
 static_assert(sizeof(GlobalCommand) == 28);
 
+// One point of a trajectory preview, packed into 32 bits (4 bytes)
+// Bits [9:0] global X speed, [19:10] global Y speed, [31:20] heading setpoint
+struct TrajectoryKnot {
+    uint32_t packed;
+
+    static constexpr int32_t SPEED_MAX_I = 511;
+
+    static constexpr int32_t round(float v) {
+        return (int32_t) (v + (v >= 0 ? 0.5f : -0.5f));
+    }
+
+    static constexpr int32_t sign_extend(uint32_t v, uint8_t bits) {
+        return (int32_t) (v << (32 - bits)) >> (32 - bits);
+    }
+
+    static constexpr uint32_t speed_to_bits(float speed) {
+        int32_t i = round(speed / Scale::TRAJECTORY_SPEED);
+        if(i > SPEED_MAX_I) i = SPEED_MAX_I;
+        if(i < -SPEED_MAX_I) i = -SPEED_MAX_I;
+        return (uint32_t) i & 0x3FF;
+    }
+
+    static constexpr TrajectoryKnot make(float global_speed_x, float global_speed_y, float heading_setpoint) {
+        return TrajectoryKnot{
+            speed_to_bits(global_speed_x)
+            | (speed_to_bits(global_speed_y) << 10)
+            | (((uint32_t) round(heading_setpoint / Scale::TRAJECTORY_HEADING) & 0xFFF) << 20)  // Wraps around at +-pi
+        };
+    }
+
+    constexpr int32_t speed_x_i() const { return sign_extend(packed & 0x3FF, 10); }
+    constexpr int32_t speed_y_i() const { return sign_extend((packed >> 10) & 0x3FF, 10); }
+    constexpr int32_t heading_i() const { return sign_extend(packed >> 20, 12); }
+
+    constexpr float speed_x() const { return speed_x_i() * Scale::TRAJECTORY_SPEED; }   // [m/s]
+    constexpr float speed_y() const { return speed_y_i() * Scale::TRAJECTORY_SPEED; }   // [m/s]
+    constexpr float heading() const { return heading_i() * Scale::TRAJECTORY_HEADING; } // [rad]
+};
+static_assert(sizeof(TrajectoryKnot) == 4);
+static_assert(TrajectoryKnot::make(-1.0, 2.0, -3.0).heading_i() == TrajectoryKnot::round(-3.0 / Scale::TRAJECTORY_HEADING));
+static_assert(TrajectoryKnot::make(-1.0, 2.0, -3.0).speed_x_i() == TrajectoryKnot::round(-1.0 / Scale::TRAJECTORY_SPEED));
+static_assert(TrajectoryKnot::make(-9.0, 9.0, 0.0).speed_y_i() == TrajectoryKnot::SPEED_MAX_I);
+
+const uint8_t TRAJECTORY_MAX_KNOTS = 4;
+const int16_t TRAJECTORY_HEADING_UNKNOWN = INT16_MIN;
+
+// Short horizon of global setpoints, interpolated on the robot (28 bytes)
+// Knot i is reached i * knot_interval after reception, the last knot is held afterwards.
+// A newer preview always replaces the older one, so lost packets only shorten the horizon.
+struct TrajectoryCommand {
+    TrajectoryKnot knots[TRAJECTORY_MAX_KNOTS];  // (16 bytes)
+
+    int16_t heading_last_measurement_i;  // Scaled with Scale::HEADING, TRAJECTORY_HEADING_UNKNOWN if not measured
+    uint8_t knot_interval;          // Time between knots [2 ms per LSB]
+    uint8_t num_knots;              // Number of valid knots (1 -> TRAJECTORY_MAX_KNOTS)
+
+    GenericCommand gen_command;
+
+    // Interpolate the setpoint (x, y: global speed, z: heading) at t_ms after reception
+    // Returns false if the preview has run out (the last knot is then returned)
+    bool sample(uint32_t t_ms, HG::Pose& setpoint) const {
+        uint8_t n = num_knots;
+        if(n > TRAJECTORY_MAX_KNOTS) n = TRAJECTORY_MAX_KNOTS;
+        uint32_t interval_ms = (uint32_t) knot_interval * 2;
+        if(n == 0) return false;
+        if(n == 1 || interval_ms == 0 || t_ms >= interval_ms * (n - 1)) {
+            setpoint = HG::Pose{knots[n - 1].speed_x(), knots[n - 1].speed_y(), knots[n - 1].heading()};
+            return n == 1 ? t_ms < interval_ms : t_ms < interval_ms * (n - 1);
+        }
+
+        const TrajectoryKnot& a = knots[t_ms / interval_ms];
+        const TrajectoryKnot& b = knots[t_ms / interval_ms + 1];
+        float f = (float) (t_ms % interval_ms) / interval_ms;
+
+        // Shortest way around, the 12 bit heading wraps at +-pi
+        int32_t dh = TrajectoryKnot::sign_extend((uint32_t) (b.heading_i() - a.heading_i()) & 0xFFF, 12);
+        float heading = (a.heading_i() + f * dh) * Scale::TRAJECTORY_HEADING;
+        if(heading >= 3.14159265f) heading -= 2 * 3.14159265f;
+        if(heading < -3.14159265f) heading += 2 * 3.14159265f;
+
+        setpoint = HG::Pose{
+            a.speed_x() + f * (b.speed_x() - a.speed_x()),
+            a.speed_y() + f * (b.speed_y() - a.speed_y()),
+            heading,
+        };
+        return true;
+    }
+
+    // The first knot as a GlobalCommand, for robots without Capability::TRAJECTORY_COMMAND
+    // A trajectory has no yaw rate limit, the robot's own limit applies
+    GlobalCommand toGlobalCommand() const {
+        GlobalCommand gc = {};
+        gc.global_speed_x = knots[0].speed_x();
+        gc.global_speed_y = knots[0].speed_y();
+        gc.heading_last_measurement = heading_last_measurement_i == TRAJECTORY_HEADING_UNKNOWN ? NAN : heading_last_measurement_i * Scale::HEADING;
+        gc.heading_setpoint = knots[0].heading();
+        gc.gen_command = gen_command;
+        gc.max_yaw_rate = UINT16_MAX;
+        return gc;
+    }
+};
+static_assert(sizeof(TrajectoryCommand) == 28);
+
 
 /* REPLY MESSAGES */
 // High frequency primary mcu status (28 bytes)
@@ -305,12 +446,69 @@ struct OverrideOdometry {
 static_assert(sizeof(OverrideOdometry) == 28);
 
 // (28 bytes)
+// Robot to base: log text at an offset in the log of the robot (see radio_log.h), not NUL terminated when full
+// Base to robot: resend the log from start_offset, text is empty
+#define RADIO_LOG_FLAG_OPEN (1 << 0)    // Base to robot: open the log. Robot to base: opened since the robot booted
 struct SerialMessage {
     uint32_t start_offset;
-    char text[24];
+    uint8_t flags;      // RADIO_LOG_FLAG_*
+    char text[23];
 };
 static_assert(sizeof(SerialMessage) == 28);
 
+// Remote SerialInterface session (see radio_shell.h), both directions (28 bytes)
+// Base to robot: command text, robot to base: output text
+#define RADIO_SHELL_FLAG_OPEN (1 << 0)  // First frame of a new session
+struct ShellMessage {
+    uint8_t seq;        // Sequence number of this frame, not incremented for frames without text
+    uint8_t ack;        // Last seq received in order from the other side
+    uint8_t len;        // Bytes of text
+    uint8_t flags;      // RADIO_SHELL_FLAG_*
+    char text[24];
+};
+static_assert(sizeof(ShellMessage) == 28);
+
+// Loop time profile of one section of the robot loop (see profiler.h), robot to base (28 bytes)
+// Sections are sent in turn at a low rate, times saturate at 65535 us
+struct LoopProfile {
+    uint8_t section;    // Index of this section
+    uint8_t sections;   // Number of sections
+    char name[6];       // Not NUL terminated when full
+
+    uint32_t count;     // Runs measured
+    uint32_t window_ms; // Time they were measured over
+
+    uint16_t min;       // [us]
+    uint16_t avg;       // [us]
+    uint16_t p50;       // [us] Percentiles are the upper bound of their histogram bucket
+    uint16_t p90;       // [us]
+    uint16_t p99;       // [us]
+    uint16_t max;       // [us]
+};
+static_assert(sizeof(LoopProfile) == 28);
+
+// Points in the handling of a traced command on the robot
+enum class TraceStage : uint8_t {
+    RECEIVED = 0,       // Read from the radio, the other stages are timed from here
+    DISPATCHED = 1,     // Command callback called
+    HANDLED = 2,        // Command callback returned
+    CAN_SENT = 3,       // Wheel command sent on the CAN bus, marked by the firmware
+    QUEUED = 4,         // This record was queued to be sent back
+};
+const uint8_t TRACE_STAGES = 5;
+
+// Timestamps of a traced Command/GlobalCommand, robot to base (28 bytes)
+struct TraceRecord {
+    uint8_t trace_id;
+    uint8_t stages;         // Bitfield by TraceStage of the stages that were reached
+    uint8_t _pad0[2];
+
+    uint32_t stage_us[TRACE_STAGES - 1];   // [us] since RECEIVED, by TraceStage - 1
+
+    uint8_t _pad[8];
+};
+static_assert(sizeof(TraceRecord) == 28);
+
 // A list of all possible message types transmitted over radio
 // Note: never repeat IDs, to avoid back-compatibility bugs
 enum class MessageType : uint8_t {
@@ -326,6 +524,11 @@ enum class MessageType : uint8_t {
     OverrideOdometry = 0x14,    // Overwrite the odometry reading
     GlobalCommand = 0x15,       // Global coordinate control
     SerialMessage = 0x16,       // Serial text message
+    TrajectoryCommand = 0x17,   // Global coordinate control with a short trajectory preview
+    Capabilities = 0x18,        // Capability advertisement/negotiation
+    ShellMessage = 0x19,        // Remote SerialInterface session
+    LoopProfile = 0x1A,         // Loop time profile of one section
+    TraceRecord = 0x1B,         // Timestamps of a traced command
 
     MultiConfigMessage = 0x20,  // Multiple Configuration Accesses
 
@@ -339,11 +542,16 @@ struct Message {
     union {
         Command c;  // 28 bytes
         GlobalCommand gc;  // 28 bytes
+        TrajectoryCommand tc;  // 28 bytes
+        Capabilities caps;  // 28 bytes
         MultiConfigMessage mcm;
         PrimaryStatusHF ps_hf; // 28 bytes
         OdometryReading odo; // 28 bytes
         OverrideOdometry over_odo; // 28 bytes
         SerialMessage serial; // 28 bytes
+        ShellMessage shell; // 28 bytes
+        LoopProfile profile; // 28 bytes
+        TraceRecord trace; // 28 bytes
         PrimaryStatusLF ps_lf; // 28 bytes
         struct {
             ImuReadings ir;
@@ -371,6 +579,27 @@ struct Message {
         this->msg.serial = serial;
     }
 
+    Message(ShellMessage shell) :
+        mt{MessageType::ShellMessage},
+        _pad{0, 0, 0}
+    {
+        this->msg.shell = shell;
+    }
+
+    Message(LoopProfile profile) :
+        mt{MessageType::LoopProfile},
+        _pad{0, 0, 0}
+    {
+        this->msg.profile = profile;
+    }
+
+    Message(TraceRecord trace) :
+        mt{MessageType::TraceRecord},
+        _pad{0, 0, 0}
+    {
+        this->msg.trace = trace;
+    }
+
     Message(Command c) :
         mt{MessageType::Command},
         _pad{0, 0, 0}
@@ -378,6 +607,27 @@ struct Message {
         this->msg.c = c;
     }
 
+    Message(GlobalCommand gc) :
+        mt{MessageType::GlobalCommand},
+        _pad{0, 0, 0}
+    {
+        this->msg.gc = gc;
+    }
+
+    Message(TrajectoryCommand tc) :
+        mt{MessageType::TrajectoryCommand},
+        _pad{0, 0, 0}
+    {
+        this->msg.tc = tc;
+    }
+
+    Message(Capabilities caps) :
+        mt{MessageType::Capabilities},
+        _pad{0, 0, 0}
+    {
+        this->msg.caps = caps;
+    }
+
     Message(OverrideOdometry over_odo) :
         mt{MessageType::OverrideOdometry},
         _pad{0, 0, 0}
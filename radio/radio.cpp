@@ -15,6 +15,14 @@ void CustomRF24::preInit(rf24_pa_dbm_e pa_level) {
 }
 
 
+void CustomRF24::setCapabilities(HG::Version version, uint32_t capabilities) {
+    version.protocols_major = CONST_PROTOCOL_VERSION_MAJOR;
+    version.protocols_minor = CONST_PROTOCOL_VERSION_MINOR;
+    own_capabilities = Radio::Capabilities{};
+    own_capabilities.version = version;
+    own_capabilities.capabilities = capabilities;
+}
+
 // Send a generic message
 bool CustomRF24::sendMessage(Radio::Message msg, bool multicast) {
     // Serial.print("MSG = ");
@@ -6,6 +6,15 @@
 #include <RF24.h>
 #include <radio/protocols_radio.h>
 #include <radio/pins_radio.h>
+#include <radio/capture.h>
+#include <radio/config_gateway.h>
+#include <radio/config_transactions.h>
+#include <radio/config_store.h>
+#include <radio/radio_log.h>
+#include <radio/radio_shell.h>
+#include <radio/radio_trace.h>
+#include <profiler.h>
+#include <variable_meta.h>
 #include <queue>
 
 class CustomRF24 : public RF24 {
@@ -15,12 +24,17 @@ class CustomRF24 : public RF24 {
 
         void receiveMessage(Radio::Message& msg);
 
+        // Set the firmware version and supported Radio::Capability bits advertised to the other side
+        void setCapabilities(HG::Version version, uint32_t capabilities);
+
         
     protected:
         uint8_t identity;
         SPIClass* spi;
         uint8_t num_radios_online = 1;
 
+        Radio::Capabilities own_capabilities = {};
+
         bool sendMessage(Radio::Message msg, bool multicast = false);
 
         template<typename T>
@@ -35,6 +49,22 @@ class CustomRF24 : public RF24 {
 
 
 const uint8_t MAX_TX_BUFFER = 5;
+#ifndef RADIO_CONFIG_MAX_HOOKS
+  #define RADIO_CONFIG_MAX_HOOKS 8
+#endif
+static_assert(RADIO_CONFIG_MAX_HOOKS <= 32, "Hooks are tracked in a 32 bit mask");
+#ifndef RADIO_CONFIG_REPLY_CACHE
+  #define RADIO_CONFIG_REPLY_CACHE 8    // Latest WRITE/SET_DEFAULT replies kept for retransmitted requests
+#endif
+#ifndef RADIO_CONFIG_REPLY_AGE_MS
+  #define RADIO_CONFIG_REPLY_AGE_MS 500 // Longer than ConfigTransactions keeps retransmitting
+#endif
+#ifndef RADIO_BACKGROUND_SLOT_INTERVAL
+  #define RADIO_BACKGROUND_SLOT_INTERVAL 8   // Telemetry slots per shell or log frame
+#endif
+#ifndef RADIO_PROFILE_INTERVAL_MS
+  #define RADIO_PROFILE_INTERVAL_MS 250     // One section of the loop profile per interval
+#endif
 class CustomRF24_Robot : public CustomRF24 {
     public:
         CustomRF24_Robot();
@@ -49,15 +79,15 @@ class CustomRF24_Robot : public CustomRF24 {
             static_assert(sizeof(T) < 5);
             switch(sizeof(T)){
                 case 1:
-                    config_access_width[(uint8_t) var] = ACCESS_WIDTH{WIDTH::B8, access};
+                    config_access_width[(uint8_t) var] = ACCESS_WIDTH{WIDTH::B8, access, false};
                     *((uint8_t*) &config_variables_defaults[(uint8_t) var]) = *((uint8_t*) ptr);
                     break;
                 case 2:
-                    config_access_width[(uint8_t) var] = ACCESS_WIDTH{WIDTH::B16, access};
+                    config_access_width[(uint8_t) var] = ACCESS_WIDTH{WIDTH::B16, access, false};
                     *((uint16_t*) &config_variables_defaults[(uint8_t) var]) = *((uint16_t*) ptr);
                     break;
                 case 4:
-                    config_access_width[(uint8_t) var] = ACCESS_WIDTH{WIDTH::B32, access};
+                    config_access_width[(uint8_t) var] = ACCESS_WIDTH{WIDTH::B32, access, false};
                     *((uint32_t*) &config_variables_defaults[(uint8_t) var]) = *((uint32_t*) ptr);
                     break;
             }
@@ -65,6 +95,16 @@ class CustomRF24_Robot : public CustomRF24 {
             
         }
 
+        // Register a configuration variable with metadata in variable_meta.h: its type is checked
+        // at compile time, and values written from the base station are kept within its range
+        template<HG::Variable var, typename T>
+        void registerVariable(T *ptr, Radio::Access access) {
+            static_assert(HG::VARIABLE_META[var].type != HG::VariableType::VOID, "Variable has no metadata in variable_meta.h");
+            static_assert(HG::variableType<T>() == HG::VARIABLE_META[var].type, "Type does not match variable_meta.h");
+            registerVariable(ptr, var, access);
+            config_access_width[(uint8_t) var].checked = true;
+        }
+
         // Add/overwrite something in tx buffer
         void writeTxBuffer(uint8_t index, Radio::Message msg);
 
@@ -75,6 +115,67 @@ class CustomRF24_Robot : public CustomRF24 {
         template<typename T>
         void registerCallback(void (*fun)(T));
 
+        // Handle a message as if it was just received (e.g. replayed from a capture)
+        // return true only on commands
+        bool handleMessage(Radio::Message msg) { return handleMessage(msg, micros()); }
+
+        // Mark a stage of a traced command, call with TraceStage::CAN_SENT when the wheel command
+        // for the latest command went out. Does nothing if it is not traced.
+        void traceStage(Radio::TraceStage stage);
+
+        // Setpoint along the latest trajectory preview, false if there is none or it has run out
+        bool sampleTrajectory(HG::Pose& setpoint);
+
+        // Set and advertise our capabilities to the base station
+        void setCapabilities(HG::Version version, uint32_t capabilities);
+
+        // Whether the base station advertised support for a feature
+        bool baseSupports(Radio::Capability c) { return Radio::hasCapability(base_capabilities, c); }
+
+        // Forward configuration of variables that are not registered here to the motor drivers
+        // The reply callback of the gateway should pass the reply on to queueMessage
+        void attachConfigGateway(Radio::ConfigGateway* gateway) { config_gateway = gateway; }
+
+        // Queue a message to be sent to the base station
+        // Configuration replies are also kept to answer retransmitted requests
+        void queueMessage(Radio::Message msg);
+
+        // Send a log to the base station in ack payload slots telemetry leaves free,
+        // its level is registered as HG::Variable::LOG_LEVEL_RADIO
+        void attachLog(Radio::RadioLog* log);
+
+        // Remote shell from the base station, output is sent in the same slots as the log
+        void attachShell(Radio::RadioShell* shell) { this->shell = shell; }
+
+        // Keep writable variables in flash: applies the stored values now, so call it after all
+        // variables are registered and before the control loop starts. A WRITE of
+        // HG::Variable::TRIGGER_SAVE requests saving all of them, see saveConfigIfRequested().
+        void attachConfigStore(Radio::ConfigStore* store);
+
+        // Save all writable variables to the config store, values back at their default are forgotten.
+        // Returns false if it failed. This blocks while flash is programmed, and a compaction erases
+        // a sector, which takes hundreds of ms on STM32: only call it where the control loop may stall.
+        bool saveConfig();
+
+        // saveConfig() if the base station wrote HG::Variable::TRIGGER_SAVE since the last call, a
+        // failure is sent to the log. Call from the loop at a safe point, e.g. while the robot is halted
+        bool saveConfigIfRequested();
+        uint32_t lastSaveMicros() const { return config_save_us; }     // Duration of the last requested save
+
+        // Call hook from applyConfigChanges() when any variable from first to last (inclusive) was
+        // changed by the base station or the config store. Returns false if there is no room
+        bool onConfigChange(HG::Variable first, HG::Variable last, void (*hook)());
+        bool onConfigChange(HG::Variable var, void (*hook)()) { return onConfigChange(var, var, hook); }
+
+        // Call the hooks of changed variables, once per hook however many of its variables changed
+        // Call from the loop where it is safe to recompute what depends on them, in the same context as run()
+        void applyConfigChanges();
+
+        // Send the loop profile to the base station, a section per RADIO_PROFILE_INTERVAL_MS at most
+        // and only once the previous one went out, and reset it once all sections were sent.
+        // The loop times of the last complete window are registered as HG::Variable::LOOP_TIME_*
+        void attachProfiler(Profiler::LoopProfiler* profiler);
+
     private:
         
         enum class WIDTH : uint8_t {
@@ -83,8 +184,9 @@ class CustomRF24_Robot : public CustomRF24 {
             B32,
         };
         struct ACCESS_WIDTH {
-            WIDTH width : 4;
+            WIDTH width : 3;
             Radio::Access access : 4;
+            bool checked : 1;       // Registered with metadata, see variable_meta.h
         };
 
 
@@ -96,14 +198,76 @@ class CustomRF24_Robot : public CustomRF24 {
         // Outgoing queue (r -> b)
         std::queue<Radio::Message> txQueue;
 
+        // Shell, log and profile frames together take one in RADIO_BACKGROUND_SLOT_INTERVAL telemetry
+        // slots, or all slots if there is no telemetry
+        Radio::RadioLog* log = nullptr;
+        Radio::RadioShell* shell = nullptr;
+        uint8_t background_slot = 0;
+        bool backgroundPending() const;
+        bool backgroundSlot();
+        void writeBackground();
+
+        // Traced command, its record is sent when the wheel command went out or after RADIO_TRACE_TIMEOUT_US
+        Radio::TraceRecord trace = {};
+        uint32_t trace_rx_us = 0;
+        bool trace_active = false;
+        void startTrace(uint8_t trace_id, uint32_t rx_us);
+        void finishTrace();
+
+        // Profile sections are sent in the same slots as the log, one at a time
+        Profiler::LoopProfiler* profiler = nullptr;
+        Radio::LoopProfile profile = {};
+        bool profile_pending = false;
+        uint8_t profile_section = 0;
+        uint32_t profile_sent_ms = 0;
+        void sendProfile();
+
         // Receive all messages and trigger callbacks
         bool receiveAndCallback();
+        bool handleMessage(Radio::Message msg, uint32_t rx_us);
 
         // Write outgoing messages to ack packets (r -> b)
         void writeTx();
 
         // Configuration variable handling (b -> r)
         void handleMultiConfigMessage(Radio::MultiConfigMessage);
+        void replyMultiConfigMessage(Radio::MultiConfigMessage mcm, uint8_t forward_mask);
+        Radio::ConfigGateway* config_gateway = nullptr;
+
+        // A retransmitted WRITE/SET_DEFAULT (same request_id and contents) gets the same reply
+        // again instead of being applied twice. Entries are dropped after RADIO_CONFIG_REPLY_AGE_MS,
+        // on a newer write to one of their variables and when the base station requests our capabilities.
+        struct CachedReply {
+            Radio::MultiConfigMessage request;
+            Radio::MultiConfigMessage reply;
+            uint32_t received_ms;
+            bool used;
+            bool done;      // false while the gateway is working on it
+        };
+        CachedReply config_replies[RADIO_CONFIG_REPLY_CACHE] = {};
+        uint8_t config_replies_next = 0;
+        bool replayMultiConfigMessage(const Radio::MultiConfigMessage& request);
+        void cacheMultiConfigReply(const Radio::MultiConfigMessage& reply);
+        void clearConfigReplies();
+
+        struct ConfigHook {
+            HG::Variable first;
+            HG::Variable last;
+            void (*hook)();
+        };
+        ConfigHook config_hooks[RADIO_CONFIG_MAX_HOOKS];
+        uint8_t num_config_hooks = 0;
+        uint32_t config_hooks_dirty = 0;   // Bit per hook
+        void markConfigChanged(HG::Variable var);
+
+        Radio::ConfigStore* config_store = nullptr;
+        bool config_save_requested = false;
+        uint32_t config_save_us = 0;
+        bool writable(HG::Variable var);
+        uint32_t readVariable(HG::Variable var, const uint32_t* from = nullptr);  // From the variable, or a copy of it
+        void writeVariable(HG::Variable var, uint32_t value);
+        bool checkValue(HG::Variable var, HG::VariableType type, uint32_t& value);     // Clamps to the range, false if rejected
+
         uint32_t* config_variables[256];    // Pointers to configuration variables
         uint32_t config_variables_defaults[256];
         ACCESS_WIDTH config_access_width[256];
@@ -121,6 +285,14 @@ class CustomRF24_Robot : public CustomRF24 {
         void (*callback_odo_reading)(Radio::OdometryReading) = nullptr;
         void (*callback_override_odo)(Radio::OverrideOdometry) = nullptr;
         void (*callback_gcommand)(Radio::GlobalCommand) = nullptr;
+        void (*callback_tcommand)(Radio::TrajectoryCommand) = nullptr;
+
+        // Latest trajectory preview, replaced by every newer one
+        Radio::TrajectoryCommand trajectory;
+        uint32_t trajectory_received = 0;   // [ms]
+        bool trajectory_valid = false;
+
+        uint32_t base_capabilities = 0;
 
         void (*callback_msg)(Radio::Message) = nullptr;
 };
@@ -142,18 +314,52 @@ class CustomRF24_Base : public CustomRF24 {
         template<typename T>
         bool sendMessageToRobot(T msg, uint8_t rx_robot) {
             this->setRxRobot(rx_robot);
-            return this->sendMessage(msg);
+            Radio::Message m{msg};
+            traceTx(m);
+            captureTx(m);
+            return this->sendMessage(m);
         }
 
+        // Robots that don't advertise Capability::TRAJECTORY_COMMAND get the first knot as a GlobalCommand
+        bool sendMessageToRobot(const Radio::TrajectoryCommand& tc, uint8_t rx_robot);
+
         template<typename T>
         bool sendMessageBroadcast(T msg) {
             this->setRxBroadcast();
-            return this->sendMessage(msg, true);
+            Radio::Message m{msg};
+            captureTx(m);
+            return this->sendMessage(m, true);
         }
 
         // Register message callback
         void registerCallback(void (*fun)(Radio::Message, Radio::SSL_ID));
 
+        // Record all received and sent messages, nullptr to stop
+        void attachCapture(Capture::Writer* capture);
+
+        // Ask a robot for its capabilities, this also advertises ours
+        bool requestCapabilities(Radio::SSL_ID robot);
+
+        // Capabilities advertised by a robot, nullptr if not known (yet)
+        const Radio::Capabilities* getCapabilities(Radio::SSL_ID robot);
+
+        // Whether both this base station and the robot support a feature
+        bool robotSupports(Radio::SSL_ID robot, Radio::Capability c);
+
+        // Reassemble the logs of the robots, resend requests are sent from run()
+        void attachLog(Radio::LogReassembler* log);
+
+        // Remote shell sessions with the robots, frames are sent from run()
+        void attachShell(Radio::RadioShellHost* shell) { this->shell = shell; }
+
+        // Trace commands to robots that support it (our capabilities must include
+        // Radio::Capability::COMMAND_TRACE), nullptr to stop
+        void attachTrace(Radio::TraceCollector* trace) { this->trace = trace; }
+
+        // Send configuration requests with retransmits, requests are sent from run() and
+        // replies are matched before the message callback
+        void attachConfigTransactions(Radio::ConfigTransactions* transactions) { config_transactions = transactions; }
+
 
     private:
         Radio::SSL_ID rx_robot = 0;
@@ -164,4 +370,24 @@ class CustomRF24_Base : public CustomRF24 {
 
         void (*callback_msg)(Radio::Message, Radio::SSL_ID) = nullptr;
 
+        Capture::Writer* capture = nullptr;
+        void captureTx(const Radio::Message& msg);
+
+        // Log resend requests, config requests and shell frames, at most one per run()
+        Radio::LogReassembler* log = nullptr;
+        Radio::RadioShellHost* shell = nullptr;
+        enum : uint8_t { BACKGROUND_LOG, BACKGROUND_CONFIG, BACKGROUND_SHELL, BACKGROUND_SOURCES };
+        uint8_t background_next = 0;
+        void sendBackground();
+        bool sendBackground(uint8_t source);
+
+        Radio::TraceCollector* trace = nullptr;
+        void traceTx(Radio::Message& msg);
+
+        Radio::ConfigTransactions* config_transactions = nullptr;
+
+        // Capability records of the robots on this radio
+        Radio::Capabilities robot_capabilities[6];  // Indexed by pipe
+        uint8_t robot_capabilities_known = 0;       // Bitfield by pipe
+
 };
@@ -26,14 +26,57 @@ bool CustomRF24_Base::init(rf24_pa_dbm_e pa_level) {
 
 bool CustomRF24_Base::run() {
     uint8_t pipe = 0;
-    if(!this->available(&pipe)){
-        // No message received
-        return false;
+    if(this->available(&pipe)) {
+        if(pipe == 0) {
+            return receiveAndCallback(this->rx_robot);  // Received on basestation backlistening pipe
+        } else {
+            return receiveAndCallback(Radio::getRobotID(pipe, identity, num_radios_online));
+        }
     }
-    if(pipe == 0) {
-        return receiveAndCallback(this->rx_robot);  // Received on basestation backlistening pipe
-    } else {
-        return receiveAndCallback(Radio::getRobotID(pipe, identity, num_radios_online));
+    // No message received
+    sendBackground();
+    return false;
+}
+
+void CustomRF24_Base::sendBackground() {
+    // Ack payloads on pipe 0 are credited to rx_robot, so only retarget once the previous write
+    // completed and its ack payload was read (the RX FIFO is empty when run() gets here)
+    if(!this->isFifo(true, true)) return;
+
+    // Round robin, so a busy shell can't hold back log resends or config retransmits
+    for(uint8_t i = 0; i < BACKGROUND_SOURCES; i++) {
+        uint8_t source = (background_next + i) % BACKGROUND_SOURCES;
+        if(sendBackground(source)) {
+            background_next = source + 1;
+            return;
+        }
+    }
+}
+
+// Send the next frame of a source, false if it has none
+bool CustomRF24_Base::sendBackground(uint8_t source) {
+    Radio::SSL_ID robot;
+    switch(source) {
+        case BACKGROUND_LOG: {
+            Radio::SerialMessage request;
+            if(log == nullptr || !log->takeRequest(robot, request)) return false;
+            sendMessageToRobot(request, robot);
+            return true;
+        }
+        case BACKGROUND_CONFIG: {
+            Radio::MultiConfigMessage request;
+            if(config_transactions == nullptr || !config_transactions->takeRequest(robot, request, millis())) return false;
+            sendMessageToRobot(request, robot);
+            return true;
+        }
+        case BACKGROUND_SHELL: {
+            Radio::ShellMessage frame;
+            if(shell == nullptr || !shell->takeFrame(robot, frame, millis())) return false;
+            sendMessageToRobot(frame, robot);
+            return true;
+        }
+        default:
+            return false;
     }
 }
 
@@ -41,8 +84,57 @@ void CustomRF24_Base::registerCallback(void (*fun)(Radio::Message, Radio::SSL_ID
     callback_msg = fun;
 }
 
+void CustomRF24_Base::attachCapture(Capture::Writer* capture) {
+    this->capture = capture;
+}
+
+void CustomRF24_Base::attachLog(Radio::LogReassembler* log) {
+    this->log = log;
+}
+
+void CustomRF24_Base::traceTx(Radio::Message& msg) {
+    if(trace == nullptr || !robotSupports(rx_robot, Radio::Capability::COMMAND_TRACE)) return;
+    if(msg.mt == Radio::MessageType::Command) {
+        trace->tag(rx_robot, msg.msg.c.trace_id, micros());
+    } else if(msg.mt == Radio::MessageType::GlobalCommand) {
+        trace->tag(rx_robot, msg.msg.gc.trace_id, micros());
+    }
+}
+
+void CustomRF24_Base::captureTx(const Radio::Message& msg) {
+    if(capture != nullptr) {
+        capture->write(micros(), Capture::Direction::TX, identity, rx_robot, msg);
+    }
+}
+
+bool CustomRF24_Base::requestCapabilities(Radio::SSL_ID robot) {
+    Radio::Capabilities caps = own_capabilities;
+    caps.request = true;
+    return sendMessageToRobot(caps, robot);
+}
+
+bool CustomRF24_Base::sendMessageToRobot(const Radio::TrajectoryCommand& tc, uint8_t rx_robot) {
+    if(robotSupports(rx_robot, Radio::Capability::TRAJECTORY_COMMAND)) {
+        return sendMessageToRobot<Radio::TrajectoryCommand>(tc, rx_robot);
+    }
+    return sendMessageToRobot(tc.toGlobalCommand(), rx_robot);
+}
+
+const Radio::Capabilities* CustomRF24_Base::getCapabilities(Radio::SSL_ID robot) {
+    uint8_t pipe = getPipe(robot);
+    if(pipe == 0 || !(robot_capabilities_known & (1 << pipe))) return nullptr;
+    return &robot_capabilities[pipe];
+}
+
+bool CustomRF24_Base::robotSupports(Radio::SSL_ID robot, Radio::Capability c) {
+    const Radio::Capabilities* caps = getCapabilities(robot);
+    if(caps == nullptr) return false;   // Unknown robots only get the baseline protocol
+    return Radio::hasCapability(caps->capabilities & own_capabilities.capabilities, c);
+}
+
 void CustomRF24_Base::openPipes(uint8_t num_radios_online) {
     this->num_radios_online = num_radios_online;
+    this->robot_capabilities_known = 0;     // Robot assignment may have changed
     this->openWritingPipe(Radio::BaseAddress_BtR + (uint64_t) this->rx_robot);
     // Open all five reading pipes (one for each robot)
     for (uint8_t pipe = 1; pipe <= 5; pipe++) {
@@ -55,6 +147,34 @@ bool CustomRF24_Base::receiveAndCallback(Radio::SSL_ID id) {
     auto size = getDynamicPayloadSize();
     receiveMessage(msg);
 
+    if(capture != nullptr) {
+        capture->write(micros(), Capture::Direction::RX, identity, id, msg);
+    }
+
+    if(msg.mt == Radio::MessageType::Capabilities) {
+        uint8_t pipe = getPipe(id);
+        if(pipe != 0) {
+            robot_capabilities[pipe] = msg.msg.caps;
+            robot_capabilities_known |= (1 << pipe);
+        }
+    }
+
+    if(msg.mt == Radio::MessageType::SerialMessage && log != nullptr) {
+        log->handle(id, msg.msg.serial, millis());
+    }
+
+    if(msg.mt == Radio::MessageType::MultiConfigMessage && config_transactions != nullptr) {
+        config_transactions->handle(id, msg.msg.mcm);
+    }
+
+    if(msg.mt == Radio::MessageType::TraceRecord && trace != nullptr) {
+        trace->handle(id, msg.msg.trace, micros());
+    }
+
+    if(msg.mt == Radio::MessageType::ShellMessage && shell != nullptr) {
+        shell->handle(id, msg.msg.shell, millis());
+    }
+
     if(callback_msg != nullptr){
         callback_msg(msg, id);
     }
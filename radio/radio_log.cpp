@@ -0,0 +1,124 @@
+#include "radio_log.h"
+#include <string.h>
+
+namespace Radio {
+
+// ---------------ROBOT----------------- //
+
+size_t RadioLog::write(uint8_t c) {
+    if(level == (uint8_t) LogLevel::OFF || c == 0) return 1;
+    if(head >= RADIO_LOG_BUFFER_SIZE && send_offset <= head - RADIO_LOG_BUFFER_SIZE) overwritten++;
+    data[head & MASK] = c;
+    head++;
+    return 1;
+}
+
+size_t RadioLog::write(const uint8_t* buffer, size_t size) {
+    for(size_t i = 0; i < size; i++) write(buffer[i]);
+    return size;
+}
+
+void RadioLog::log(LogLevel l, const char* text) {
+    if(!enabled(l)) return;
+    print(text);
+    print('\n');
+}
+
+bool RadioLog::nextChunk(SerialMessage& chunk) {
+    if(send_offset < oldest()) send_offset = oldest();     // Overwritten before it was sent
+    if(!pending()) return false;
+
+    uint32_t n = head - send_offset;
+    if(n > LOG_CHUNK_SIZE) n = LOG_CHUNK_SIZE;
+    chunk.start_offset = send_offset;
+    chunk.flags = open ? RADIO_LOG_FLAG_OPEN : 0;
+    memset(chunk.text, 0, sizeof(chunk.text));
+    for(uint32_t i = 0; i < n; i++) chunk.text[i] = data[(send_offset + i) & MASK];
+    send_offset += n;
+    return true;
+}
+
+void RadioLog::handle(const SerialMessage& request) {
+    if(request.flags & RADIO_LOG_FLAG_OPEN) open = true;
+    resendFrom(request.start_offset);
+}
+
+void RadioLog::resendFrom(uint32_t offset) {
+    if(offset >= send_offset) return;
+    send_offset = offset < oldest() ? oldest() : offset;
+}
+
+
+// ---------------BASE------------------ //
+
+LogReassembler::LogReassembler(Output output, uint32_t resend_timeout_ms)
+    : output{output}, resend_timeout_ms{resend_timeout_ms}
+{
+    memset(streams, 0, sizeof(streams));
+}
+
+void LogReassembler::handle(Radio::SSL_ID robot, const SerialMessage& chunk, uint32_t now_ms) {
+    if(robot >= RADIO_LOG_MAX_ROBOTS) return;
+    Stream& s = streams[robot];
+    uint32_t len = strnlen(chunk.text, sizeof(chunk.text));
+    uint32_t start = chunk.start_offset;
+
+    // Robot rebooted: its log is no longer open, or its offsets started over. The new log starts at 0
+    bool robot_open = chunk.flags & RADIO_LOG_FLAG_OPEN;
+    if(s.active && ((s.robot_open && !robot_open) || start + RADIO_LOG_BUFFER_SIZE < s.expected)) {
+        s = Stream{0, 0, s.lost, 0, false, false, true, false, false, 0};
+    }
+    if(!s.active) {
+        s = Stream{start, 0, 0, 0, false, false, true, false, false, 0};
+    }
+
+    // Open it, so the next reboot is noticed
+    s.robot_open = robot_open;
+    if(!robot_open && (!s.open_requested || now_ms - s.open_requested_ms >= resend_timeout_ms)) {
+        s.open_requested = true;
+        s.open_requested_ms = now_ms;
+        s.request_pending = true;
+    }
+
+    if(start + len <= s.expected) return;   // Already have it
+
+    if(start > s.expected) {
+        if(s.requested && now_ms - s.requested_ms < resend_timeout_ms) return;   // Chunks that were already on their way
+        if(s.attempts < RADIO_LOG_MAX_RESENDS) {
+            s.attempts++;
+            s.requested = true;
+            s.request_pending = true;
+            s.requested_ms = now_ms;
+            return;
+        }
+
+        // The robot doesn't have it anymore
+        s.lost += start - s.expected;
+        s.expected = start;
+    }
+
+    uint32_t skip = s.expected - start;
+    if(output != nullptr) output(robot, chunk.text + skip, len - skip);
+    s.expected = start + len;
+    s.requested = false;
+    s.attempts = 0;
+}
+
+bool LogReassembler::takeRequest(Radio::SSL_ID& robot, SerialMessage& request) {
+    for(uint8_t i = 0; i < RADIO_LOG_MAX_ROBOTS; i++) {
+        if(!streams[i].request_pending) continue;
+        streams[i].request_pending = false;
+        robot = i;
+        request.start_offset = streams[i].expected;
+        request.flags = streams[i].robot_open ? 0 : RADIO_LOG_FLAG_OPEN;
+        memset(request.text, 0, sizeof(request.text));
+        return true;
+    }
+    return false;
+}
+
+uint32_t LogReassembler::lostCount(Radio::SSL_ID robot) const {
+    return robot < RADIO_LOG_MAX_ROBOTS ? streams[robot].lost : 0;
+}
+
+} // namespace Radio
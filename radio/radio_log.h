@@ -0,0 +1,126 @@
+// Delft Mercurians
+// 2026-10-19
+
+// Log channel from the robots to the base station over Radio::SerialMessage
+//
+// The robot prints its log into a RadioLog ring buffer. Every byte has an absolute offset
+// (bytes written since boot), chunks of up to 23 bytes are sent in ack payload slots that
+// telemetry leaves free, see CustomRF24_Robot::attachLog.
+// The base station puts the chunks of every robot back in order with a LogReassembler. When
+// chunks are missing it asks the robot to resend from the first missing offset, with a
+// SerialMessage to the robot. Text that was overwritten on the robot in the meantime is lost,
+// and counted. Gaps are found from the next chunk, so a lost last chunk is only recovered
+// once the robot logs something again.
+//
+// The base station opens the log of every robot it hears from with RADIO_LOG_FLAG_OPEN, and the
+// robot sets the flag in its chunks from then on. A chunk without it from a robot that was open
+// means the robot rebooted, so its offsets start over, also when the old log was still short.
+
+#pragma once
+#include <Arduino.h>
+#include "protocols_radio.h"
+
+#ifndef RADIO_LOG_BUFFER_SIZE
+  #define RADIO_LOG_BUFFER_SIZE 1024
+#endif
+
+// Resend requests for a gap before the text is counted as lost
+#ifndef RADIO_LOG_MAX_RESENDS
+  #define RADIO_LOG_MAX_RESENDS 3
+#endif
+
+// Robots the reassembler keeps track of (SSL IDs 0 -> 15)
+#ifndef RADIO_LOG_MAX_ROBOTS
+  #define RADIO_LOG_MAX_ROBOTS 16
+#endif
+
+namespace Radio {
+
+enum class LogLevel : uint8_t {
+    OFF = 0,
+    ERROR = 1,
+    WARNING = 2,
+    INFO = 3,
+    DEBUG = 4,
+};
+
+constexpr uint8_t LOG_CHUNK_SIZE = sizeof(SerialMessage::text);
+
+// Robot side
+class RadioLog : public Print {
+    public:
+        static_assert((RADIO_LOG_BUFFER_SIZE & (RADIO_LOG_BUFFER_SIZE - 1)) == 0, "Size must be a power of 2");
+
+        // Threshold, registered as HG::Variable::LOG_LEVEL_RADIO by CustomRF24_Robot::attachLog
+        uint8_t level = (uint8_t) LogLevel::INFO;
+
+        bool enabled(LogLevel l) const { return l != LogLevel::OFF && (uint8_t) l <= level; }
+
+        size_t write(uint8_t c) override;
+        size_t write(const uint8_t* buffer, size_t size) override;
+        int availableForWrite() override { return RADIO_LOG_BUFFER_SIZE; }    // Never blocks, overwrites the oldest text
+
+        // Print a line if the level is enabled
+        void log(LogLevel l, const char* text);
+
+        bool pending() const { return send_offset != head; }
+
+        // Next chunk to send, false if there is nothing to send
+        bool nextChunk(SerialMessage& chunk);
+
+        // Request from the base station: open the log and/or resend from an offset
+        void handle(const SerialMessage& request);
+        void resendFrom(uint32_t offset);
+
+        uint32_t writtenCount() const { return head; }
+        uint32_t overwrittenCount() const { return overwritten; }  // Bytes overwritten before they were sent
+
+    private:
+        static constexpr uint32_t MASK = RADIO_LOG_BUFFER_SIZE - 1;
+
+        char data[RADIO_LOG_BUFFER_SIZE];
+        uint32_t head = 0;          // Offset of the next byte written
+        uint32_t send_offset = 0;   // Offset of the next byte sent
+        uint32_t overwritten = 0;
+        bool open = false;          // Opened by the base station since boot
+
+        uint32_t oldest() const { return head > RADIO_LOG_BUFFER_SIZE ? head - RADIO_LOG_BUFFER_SIZE : 0; }
+};
+
+
+// Base station side
+class LogReassembler {
+    public:
+        typedef void (*Output)(Radio::SSL_ID robot, const char* text, uint8_t len);
+
+        // output gets the text of every robot in order, without duplicates
+        LogReassembler(Output output, uint32_t resend_timeout_ms = 100);
+
+        // Handle a SerialMessage from a robot
+        void handle(Radio::SSL_ID robot, const SerialMessage& chunk, uint32_t now_ms);
+
+        // Resend request to send to a robot, false if there is none
+        bool takeRequest(Radio::SSL_ID& robot, SerialMessage& request);
+
+        uint32_t lostCount(Radio::SSL_ID robot) const;  // Bytes that could not be recovered
+
+    private:
+        struct Stream {
+            uint32_t expected;          // Offset of the next byte to output
+            uint32_t requested_ms;
+            uint32_t lost;
+            uint8_t attempts;           // Resend requests for the same gap
+            bool requested;             // A resend from expected was requested
+            bool request_pending;       // Not sent yet
+            bool active;
+            bool robot_open;            // Last chunk had RADIO_LOG_FLAG_OPEN
+            bool open_requested;
+            uint32_t open_requested_ms;
+        };
+
+        Output output;
+        uint32_t resend_timeout_ms;
+        Stream streams[RADIO_LOG_MAX_ROBOTS];
+};
+
+} // namespace Radio
@@ -1,5 +1,7 @@
 #include "radio.h"
 #include "radio/protocols_radio.h"
+#include <math.h>
+#include <string.h>
 
 // --------------ROBOT------------------ //
 
@@ -27,7 +29,193 @@ bool CustomRF24_Robot::init(uint8_t robot, uint8_t channel, rf24_pa_dbm_e pa_lev
     return this->isChipConnected();
 }
 
+void CustomRF24_Robot::replyMultiConfigMessage(Radio::MultiConfigMessage mcm, uint8_t forward_mask) {
+    // The gateway sends the reply once the motor drivers answered
+    if(forward_mask != 0 && config_gateway->submit(mcm, forward_mask, millis())) return;
+    for(uint8_t i = 0; i < 5; i++) {
+        if(forward_mask & (1 << i)) mcm.vars[i] = HG::Variable::NONE;  // Gateway is full
+    }
+    queueMessage(Radio::Message{mcm});
+}
+
+static bool isConfigWrite(HG::ConfigOperation op) {
+    return op == HG::ConfigOperation::WRITE || op == HG::ConfigOperation::SET_DEFAULT;
+}
+
+static bool sharesVariable(const Radio::MultiConfigMessage& a, const Radio::MultiConfigMessage& b) {
+    for(uint8_t i = 0; i < 5; i++) {
+        if(a.vars[i] == HG::Variable::NONE) continue;
+        for(uint8_t j = 0; j < 5; j++) {
+            if(a.vars[i] == b.vars[j]) return true;
+        }
+    }
+    return false;
+}
+
+bool CustomRF24_Robot::replayMultiConfigMessage(const Radio::MultiConfigMessage& request) {
+    if(request.request_id == 0 || !isConfigWrite(request.operation)) return false;
+
+    // Retransmits come within the retry time of the base station. Older entries can only match a
+    // request from a restarted base station, whose request_ids start over.
+    uint32_t now = millis();
+    for(CachedReply& c : config_replies) {
+        if(c.used && now - c.received_ms >= RADIO_CONFIG_REPLY_AGE_MS) c.used = false;
+    }
+
+    for(CachedReply& c : config_replies) {
+        if(!c.used || memcmp(&c.request, &request, sizeof(request)) != 0) continue;
+        if(c.done) txQueue.push(Radio::Message{c.reply});
+        return true;    // Still at the gateway otherwise, its reply is on the way
+    }
+
+    // A new write to a variable means earlier requests for it are finished (ConfigTransactions
+    // waits for them), so a repeat of one of those is a new write as well
+    for(CachedReply& c : config_replies) {
+        if(c.used && sharesVariable(c.request, request)) c.used = false;
+    }
+
+    CachedReply& c = config_replies[config_replies_next];
+    config_replies_next = (config_replies_next + 1) % RADIO_CONFIG_REPLY_CACHE;
+    c.request = request;
+    c.received_ms = now;
+    c.used = true;
+    c.done = false;
+    return false;
+}
+
+void CustomRF24_Robot::clearConfigReplies() {
+    for(CachedReply& c : config_replies) c.used = false;
+}
+
+void CustomRF24_Robot::cacheMultiConfigReply(const Radio::MultiConfigMessage& reply) {
+    if(reply.request_id == 0) return;
+    for(CachedReply& c : config_replies) {
+        if(!c.used || c.done || c.request.request_id != reply.request_id) continue;
+        c.reply = reply;
+        c.done = true;
+        return;
+    }
+}
+
+void CustomRF24_Robot::queueMessage(Radio::Message msg) {
+    if(msg.mt == Radio::MessageType::MultiConfigMessage) cacheMultiConfigReply(msg.msg.mcm);
+    txQueue.push(msg);
+}
+
+bool CustomRF24_Robot::writable(HG::Variable var) {
+    if(config_variables[(uint8_t) var] == nullptr) return false;
+    Radio::Access access = config_access_width[(uint8_t) var].access;
+    return access == Radio::Access::WRITE || access == Radio::Access::READWRITE;
+}
+
+uint32_t CustomRF24_Robot::readVariable(HG::Variable var, const uint32_t* from) {
+    if(from == nullptr) from = config_variables[(uint8_t) var];
+    switch(config_access_width[(uint8_t) var].width) {
+        case WIDTH::B8: return *((const uint8_t*) from);
+        case WIDTH::B16: return *((const uint16_t*) from);
+        default: return *from;
+    }
+}
+
+void CustomRF24_Robot::writeVariable(HG::Variable var, uint32_t value) {
+    switch(config_access_width[(uint8_t) var].width) {
+        case WIDTH::B8: *config_variables_ptr<uint8_t>(var) = value; break;
+        case WIDTH::B16: *config_variables_ptr<uint16_t>(var) = value; break;
+        case WIDTH::B32: *config_variables_ptr<uint32_t>(var) = value; break;
+    }
+}
+
+void CustomRF24_Robot::attachConfigStore(Radio::ConfigStore* store) {
+    config_store = store;
+    if(store == nullptr) return;
+    for(uint16_t v = 0; v < 256; v++) {
+        HG::Variable var = (HG::Variable) v;
+        if(!store->stored(var) || !writable(var)) continue;
+        uint32_t value = store->value(var);
+        if(config_access_width[v].checked && !checkValue(var, HG::VariableType::VOID, value)) continue;
+        if(readVariable(var) == value) continue;
+        writeVariable(var, value);
+        markConfigChanged(var);
+    }
+}
+
+bool CustomRF24_Robot::checkValue(HG::Variable var, HG::VariableType type, uint32_t& value) {
+    const HG::VariableMeta& meta = HG::VARIABLE_META[var];
+    if(meta.type == HG::VariableType::VOID) return true;
+    if(type != HG::VariableType::VOID && type != meta.type) return false;   // Sent as another type
+
+    float f;
+    switch(meta.type) {
+        case HG::VariableType::F32:
+            memcpy(&f, &value, sizeof(f));
+            if(!isfinite(f)) return false;
+            break;
+        case HG::VariableType::I32: f = (int32_t) value; break;
+        case HG::VariableType::I16: f = (int16_t) value; break;
+        case HG::VariableType::I8: f = (int8_t) value; break;
+        default: f = value; break;
+    }
+    if(f >= meta.min && f <= meta.max) return true;
+
+    f = f < meta.min ? meta.min : meta.max;
+    switch(meta.type) {
+        case HG::VariableType::F32: memcpy(&value, &f, sizeof(value)); break;
+        case HG::VariableType::I32:
+        case HG::VariableType::I16:
+        case HG::VariableType::I8: value = (uint32_t) (int32_t) f; break;
+        default: value = (uint32_t) f; break;
+    }
+    return true;
+}
+
+bool CustomRF24_Robot::onConfigChange(HG::Variable first, HG::Variable last, void (*hook)()) {
+    if(num_config_hooks >= RADIO_CONFIG_MAX_HOOKS || hook == nullptr) return false;
+    config_hooks[num_config_hooks++] = ConfigHook{first, last, hook};
+    return true;
+}
+
+void CustomRF24_Robot::markConfigChanged(HG::Variable var) {
+    for(uint8_t i = 0; i < num_config_hooks; i++) {
+        if(var >= config_hooks[i].first && var <= config_hooks[i].last) config_hooks_dirty |= 1UL << i;
+    }
+}
+
+void CustomRF24_Robot::applyConfigChanges() {
+    if(config_hooks_dirty == 0) return;
+    uint32_t dirty = config_hooks_dirty;
+    config_hooks_dirty = 0;
+    for(uint8_t i = 0; i < num_config_hooks; i++) {
+        if(dirty & (1UL << i)) config_hooks[i].hook();
+    }
+}
+
+bool CustomRF24_Robot::saveConfig() {
+    if(config_store == nullptr) return false;
+    bool ok = true;
+    for(uint16_t v = 0; v < 256; v++) {
+        HG::Variable var = (HG::Variable) v;
+        if(!writable(var)) continue;
+        uint32_t value = readVariable(var);
+        bool is_default = value == readVariable(var, &config_variables_defaults[v]);
+        ok &= is_default ? config_store->forget(var) : config_store->save(var, value);
+    }
+    return ok;
+}
+
+bool CustomRF24_Robot::saveConfigIfRequested() {
+    if(!config_save_requested) return true;
+    config_save_requested = false;
+    uint32_t start = micros();
+    bool ok = saveConfig();
+    config_save_us = micros() - start;
+    if(!ok && log != nullptr) log->log(Radio::LogLevel::ERROR, "Saving the config failed");
+    return ok;
+}
+
 void CustomRF24_Robot::handleMultiConfigMessage(Radio::MultiConfigMessage mcm) {
+    if(replayMultiConfigMessage(mcm)) return;
+
+    uint8_t forward_mask = 0;   // Variables for the config gateway
     switch(mcm.operation) {
         case HG::ConfigOperation::READ:
             // Send back variable value
@@ -35,6 +223,10 @@ void CustomRF24_Robot::handleMultiConfigMessage(Radio::MultiConfigMessage mcm) {
                 for(uint8_t i = 0; i < 5; i++) {
                     if(mcm.vars[i] == HG::Variable::NONE) continue;
                     if(this->config_variables[(uint8_t) mcm.vars[i]] == nullptr) {
+                        if(config_gateway != nullptr && config_gateway->forwards(mcm.vars[i])) {
+                            forward_mask |= 1 << i; // Variable lives on a motor driver
+                            continue;
+                        }
                         mcm.vars[i] = HG::Variable::NONE; // Variable is not available
                         continue;
                     }
@@ -61,7 +253,7 @@ void CustomRF24_Robot::handleMultiConfigMessage(Radio::MultiConfigMessage mcm) {
                     }
                 }
                 mcm.operation = HG::ConfigOperation::READ_RETURN;
-                txQueue.push(Radio::Message{mcm});
+                replyMultiConfigMessage(mcm, forward_mask);
             }
             break;
         case HG::ConfigOperation::WRITE:
@@ -69,7 +261,19 @@ void CustomRF24_Robot::handleMultiConfigMessage(Radio::MultiConfigMessage mcm) {
             {
                 for(uint8_t i = 0; i < 5; i++) {
                     if(mcm.vars[i] == HG::Variable::NONE) continue;
+                    if(mcm.vars[i] == HG::Variable::TRIGGER_SAVE && config_store != nullptr) {
+                        config_save_requested = true;   // Saved by saveConfigIfRequested(), flash blocks too long for here
+                        continue;
+                    }
                     if(this->config_variables[(uint8_t) mcm.vars[i]] == nullptr){
+                        if(config_gateway != nullptr && config_gateway->forwards(mcm.vars[i])) {
+                            if(!checkValue(mcm.vars[i], mcm.type, mcm.values[i])) {
+                                mcm.vars[i] = HG::Variable::NONE; // Value is not valid
+                                continue;
+                            }
+                            forward_mask |= 1 << i; // Variable lives on a motor driver
+                            continue;
+                        }
                         mcm.vars[i] = HG::Variable::NONE; // Variable is not available
                         continue;
                     };
@@ -82,26 +286,18 @@ void CustomRF24_Robot::handleMultiConfigMessage(Radio::MultiConfigMessage mcm) {
                         case Radio::Access::READWRITE:
                             break;
                     }
-                    switch(this->config_access_width[(uint8_t) mcm.vars[i]].width) {
-                        case WIDTH::B8:
-                            *config_variables_ptr<uint8_t>(mcm.vars[i]) = *((uint8_t*) &mcm.values[i]);
-                            mcm.values[i] = 0;
-                            *((uint8_t*) &mcm.values[i]) = *config_variables_ptr<uint8_t>(mcm.vars[i]);
-                            break;
-                        case WIDTH::B16:
-                            *config_variables_ptr<uint16_t>(mcm.vars[i]) = *((uint16_t*) &mcm.values[i]);
-                            mcm.values[i] = 0;
-                            *((uint16_t*) &mcm.values[i]) = *config_variables_ptr<uint16_t>(mcm.vars[i]);
-                            break;
-                        case WIDTH::B32:
-                            *config_variables_ptr<uint32_t>(mcm.vars[i]) = *((uint32_t*) &mcm.values[i]);
-                            mcm.values[i] = 0;
-                            *((uint32_t*) &mcm.values[i]) = *config_variables_ptr<uint32_t>(mcm.vars[i]);
-                            break;
+                    uint32_t value = readVariable(mcm.vars[i], &mcm.values[i]);
+                    if(config_access_width[(uint8_t) mcm.vars[i]].checked && !checkValue(mcm.vars[i], mcm.type, value)) {
+                        mcm.vars[i] = HG::Variable::NONE; // Value is not valid
+                        continue;
                     }
+                    uint32_t old_value = readVariable(mcm.vars[i]);
+                    writeVariable(mcm.vars[i], value);
+                    mcm.values[i] = readVariable(mcm.vars[i]);
+                    if(mcm.values[i] != old_value) markConfigChanged(mcm.vars[i]);
                 }
                 mcm.operation = HG::ConfigOperation::WRITE_RETURN;
-                txQueue.push(Radio::Message{mcm});
+                replyMultiConfigMessage(mcm, forward_mask);
             }
             break;
         case HG::ConfigOperation::SET_DEFAULT:
@@ -122,24 +318,19 @@ void CustomRF24_Robot::handleMultiConfigMessage(Radio::MultiConfigMessage mcm) {
                         case Radio::Access::READWRITE:
                             break;
                     }
-                    mcm.values[i] = 0;
-                    switch(this->config_access_width[(uint8_t) mcm.vars[i]].width) {
-                        case WIDTH::B8:
-                            *config_variables_ptr<uint8_t>(mcm.vars[i]) = *((uint8_t*) &config_variables_defaults[(uint8_t) mcm.vars[i]]);
-                            *((uint8_t*) &mcm.values[i]) = *config_variables_ptr<uint8_t>(mcm.vars[i]);
-                            break;
-                        case WIDTH::B16:
-                            *config_variables_ptr<uint16_t>(mcm.vars[i]) = *((uint16_t*) &config_variables_defaults[(uint8_t) mcm.vars[i]]);
-                            *((uint16_t*) &mcm.values[i]) = *config_variables_ptr<uint16_t>(mcm.vars[i]);
-                            break;
-                        case WIDTH::B32:
-                            *config_variables_ptr<uint32_t>(mcm.vars[i]) = *((uint32_t*) &config_variables_defaults[(uint8_t) mcm.vars[i]]);
-                            *((uint32_t*) &mcm.values[i]) = *config_variables_ptr<uint32_t>(mcm.vars[i]);
-                            break;
+                    // The default is the value the firmware registered, checked like any other write
+                    uint32_t value = readVariable(mcm.vars[i], &config_variables_defaults[(uint8_t) mcm.vars[i]]);
+                    if(this->config_access_width[(uint8_t) mcm.vars[i]].checked && !checkValue(mcm.vars[i], HG::VariableType::VOID, value)) {
+                        mcm.vars[i] = HG::Variable::NONE; // Default is not finite
+                        continue;
                     }
+                    uint32_t old_value = readVariable(mcm.vars[i]);
+                    writeVariable(mcm.vars[i], value);
+                    mcm.values[i] = readVariable(mcm.vars[i]);
+                    if(mcm.values[i] != old_value) markConfigChanged(mcm.vars[i]);
                 }
                 mcm.operation = HG::ConfigOperation::SET_DEFAULT_RETURN;
-                txQueue.push(Radio::Message{mcm});
+                queueMessage(Radio::Message{mcm});
             }
             break;
         default:
@@ -155,6 +346,9 @@ void CustomRF24_Robot::writeTxBuffer(uint8_t index, Radio::Message msg) {
 }
 
 bool CustomRF24_Robot::run() {
+    sendProfile();
+    if(trace_active && micros() - trace_rx_us > RADIO_TRACE_TIMEOUT_US) finishTrace();
+
     // Receive
     uint8_t pipe = 0;
     if(!this->available(&pipe)){
@@ -174,24 +368,129 @@ void CustomRF24_Robot::writeTx() {
     // Fill TX buffer
     // this->flush_tx();
     // if(tx_buffer_len >= 1) {
-    if(this->txQueue.empty()) {
-        this->writeAckPayload(1, &txBuffer[tx_rotate%tx_buffer_len], sizeof(txBuffer[0]));
-        tx_rotate++;
-    } else {
+    if(!this->txQueue.empty()) {
         this->writeAckPayload(1, &this->txQueue.front(), sizeof(txBuffer[0]));
         this->txQueue.pop();
+    } else if(backgroundPending() && backgroundSlot()) {
+        writeBackground();
+    } else if(tx_buffer_len > 0) {
+        this->writeAckPayload(1, &txBuffer[tx_rotate%tx_buffer_len], sizeof(txBuffer[0]));
+        tx_rotate++;
     }
 	//     this->writeAckPayload(1, &txBuffer[(tx_rotate + 1)%tx_buffer_len], sizeof(txBuffer[0]));
 	//     this->writeAckPayload(1, &txBuffer[(tx_rotate + 2)%tx_buffer_len], sizeof(txBuffer[0]));
     // }
 }
 
+bool CustomRF24_Robot::backgroundPending() const {
+    return (shell != nullptr && shell->pending()) || (log != nullptr && log->pending()) || profile_pending;
+}
+
+// One frame per background slot: the shell before the log, someone is waiting for it, the profile last
+void CustomRF24_Robot::writeBackground() {
+    if(shell != nullptr && shell->pending()) {
+        Radio::ShellMessage frame;
+        if(shell->nextFrame(frame)) {
+            Radio::Message msg{frame};
+            this->writeAckPayload(1, &msg, sizeof(msg));
+        }
+    } else if(log != nullptr && log->pending()) {
+        Radio::SerialMessage chunk;
+        if(log->nextChunk(chunk)) {
+            Radio::Message msg{chunk};
+            this->writeAckPayload(1, &msg, sizeof(msg));
+        }
+    } else if(profile_pending) {
+        Radio::Message msg{profile};
+        this->writeAckPayload(1, &msg, sizeof(msg));
+        profile_pending = false;
+    }
+}
+
+// Lowest priority, telemetry keeps most of the slots. Call once per slot, it counts them
+bool CustomRF24_Robot::backgroundSlot() {
+    if(tx_buffer_len > 0 && ++background_slot < RADIO_BACKGROUND_SLOT_INTERVAL) return false;
+    background_slot = 0;
+    return true;
+}
+
+void CustomRF24_Robot::setCapabilities(HG::Version version, uint32_t capabilities) {
+    CustomRF24::setCapabilities(version, capabilities);
+    txQueue.push(Radio::Message{own_capabilities});  // Unsolicited advertisement
+}
+
+void CustomRF24_Robot::attachLog(Radio::RadioLog* log) {
+    this->log = log;
+    if(log != nullptr) {
+        registerVariable<HG::Variable::LOG_LEVEL_RADIO>(&log->level, Radio::Access::READWRITE);
+    }
+}
+
+void CustomRF24_Robot::attachProfiler(Profiler::LoopProfiler* profiler) {
+    this->profiler = profiler;
+    if(profiler != nullptr) {
+        registerVariable<HG::Variable::LOOP_TIME_AVG>(&profiler->loop_avg, Radio::Access::READ);
+        registerVariable<HG::Variable::LOOP_TIME_P99>(&profiler->loop_p99, Radio::Access::READ);
+        registerVariable<HG::Variable::LOOP_TIME_MAX>(&profiler->loop_max, Radio::Access::READ);
+    }
+}
+
+void CustomRF24_Robot::sendProfile() {
+    // One section at a time, the next one waits until writeTx() took this one
+    if(profiler == nullptr || profile_pending || millis() - profile_sent_ms < RADIO_PROFILE_INTERVAL_MS) return;
+    profile_sent_ms = millis();
+
+    profiler->fill(profile, profile_section++);
+    profile_pending = true;
+
+    // All sections were sent, start a new window
+    if(profile_section >= profiler->sectionCount()) {
+        profiler->publish();
+        profiler->reset();
+        profile_section = 0;
+    }
+}
+
+void CustomRF24_Robot::startTrace(uint8_t trace_id, uint32_t rx_us) {
+    if(trace_active) finishTrace();     // Send what the previous one got to
+    trace = Radio::TraceRecord{};
+    trace.trace_id = trace_id;
+    trace.stages = 1 << (uint8_t) Radio::TraceStage::RECEIVED;
+    trace_rx_us = rx_us;
+    trace_active = true;
+}
+
+void CustomRF24_Robot::traceStage(Radio::TraceStage stage) {
+    uint8_t bit = 1 << (uint8_t) stage;
+    if(!trace_active || stage == Radio::TraceStage::RECEIVED || (trace.stages & bit)) return;
+    trace.stage_us[(uint8_t) stage - 1] = micros() - trace_rx_us;
+    trace.stages |= bit;
+    if(stage == Radio::TraceStage::CAN_SENT) finishTrace();
+}
+
+void CustomRF24_Robot::finishTrace() {
+    trace.stage_us[(uint8_t) Radio::TraceStage::QUEUED - 1] = micros() - trace_rx_us;
+    trace.stages |= 1 << (uint8_t) Radio::TraceStage::QUEUED;
+    trace_active = false;
+    txQueue.push(Radio::Message{trace});
+}
+
+bool CustomRF24_Robot::sampleTrajectory(HG::Pose& setpoint) {
+    if(!trajectory_valid) return false;
+    return trajectory.sample(millis() - trajectory_received, setpoint);
+}
+
 // return true only on commands
 bool CustomRF24_Robot::receiveAndCallback() {
     Radio::Message msg;
+    uint32_t rx_us = micros();
     auto size = getDynamicPayloadSize();
     receiveMessage(msg);
 
+    return handleMessage(msg, rx_us);
+}
+
+bool CustomRF24_Robot::handleMessage(Radio::Message msg, uint32_t rx_us) {
     if(callback_msg != nullptr){
         callback_msg(msg);
     }
@@ -202,15 +501,47 @@ bool CustomRF24_Robot::receiveAndCallback() {
             handleMultiConfigMessage(msg.msg.mcm);
             return false;
         case Radio::MessageType::Command:
+            if(msg.msg.c.trace_id != 0) startTrace(msg.msg.c.trace_id, rx_us);
             if(callback_command != nullptr){
+                traceStage(Radio::TraceStage::DISPATCHED);
                 callback_command(msg.msg.c);
+                traceStage(Radio::TraceStage::HANDLED);
             }
             return true;
         case Radio::MessageType::GlobalCommand:
+            if(msg.msg.gc.trace_id != 0) startTrace(msg.msg.gc.trace_id, rx_us);
             if(callback_gcommand != nullptr){
+                traceStage(Radio::TraceStage::DISPATCHED);
                 callback_gcommand(msg.msg.gc);
+                traceStage(Radio::TraceStage::HANDLED);
+            }
+            return true;
+        case Radio::MessageType::TrajectoryCommand:
+            trajectory = msg.msg.tc;
+            trajectory_received = millis();
+            trajectory_valid = true;
+            if(callback_tcommand != nullptr){
+                callback_tcommand(msg.msg.tc);
             }
             return true;
+        case Radio::MessageType::SerialMessage:
+            // Log open or resend request
+            if(log != nullptr) {
+                log->handle(msg.msg.serial);
+            }
+            return false;
+        case Radio::MessageType::ShellMessage:
+            if(shell != nullptr) {
+                shell->handle(msg.msg.shell);
+            }
+            return false;
+        case Radio::MessageType::Capabilities:
+            base_capabilities = msg.msg.caps.capabilities;
+            if(msg.msg.caps.request) {
+                clearConfigReplies();   // Base station (re)connected, its request_ids start over
+                txQueue.push(Radio::Message{own_capabilities});
+            }
+            return false;
         case Radio::MessageType::PrimaryStatusHF:
             if(callback_status_hf != nullptr){
                 callback_status_hf(msg.msg.ps_hf);
@@ -265,6 +596,11 @@ void CustomRF24_Robot::registerCallback<Radio::GlobalCommand>(void (*fun)(Radio:
     callback_gcommand = fun;
 }
 
+template<>
+void CustomRF24_Robot::registerCallback<Radio::TrajectoryCommand>(void (*fun)(Radio::TrajectoryCommand)) {
+    callback_tcommand = fun;
+}
+
 template<>
 void CustomRF24_Robot::registerCallback<Radio::Message>(void (*fun)(Radio::Message)) {
     callback_msg = fun;
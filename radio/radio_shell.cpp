@@ -0,0 +1,194 @@
+#include "radio_shell.h"
+#include <string.h>
+
+namespace Radio {
+
+// ---------------ROBOT----------------- //
+
+void RadioShell::handle(const ShellMessage& frame) {
+    uint8_t len = frame.len > SHELL_CHUNK_SIZE ? SHELL_CHUNK_SIZE : frame.len;
+
+    if(frame.flags & RADIO_SHELL_FLAG_OPEN) {
+        if(open && frame.seq == last_seq) {
+            ack_pending = true;     // Resent, the acknowledge was lost
+            return;
+        }
+        open = true;
+        line_len = 0;
+        line_too_long = false;
+    } else if(len == 0) {
+        // Poll for output, the base station only gets a reply if the session is gone
+        if(!open) ack_pending = true;
+        return;
+    } else if(!open || frame.seq != (uint8_t) (last_seq + 1)) {
+        ack_pending = true;         // Resent or out of order
+        return;
+    }
+    last_seq = frame.seq;
+    ack_pending = true;
+
+    // Same line handling as SerialInterface::run()
+    for(uint8_t i = 0; i < len; i++) {
+        char c = frame.text[i];
+        if(c == '\n' || c == '\r' || c == ';') {
+            if(line_too_long) {
+                output.printf("Line too long, max %d characters\n", SERIAL_INTERFACE_LINE_LENGTH - 1);
+                line_too_long = false;
+            } else {
+                line[line_len] = c;
+                runLine();
+            }
+            line_len = 0;
+        } else if(line_len < SERIAL_INTERFACE_LINE_LENGTH - 1) {
+            line[line_len++] = c;
+        } else {
+            line_too_long = true;
+        }
+    }
+}
+
+void RadioShell::runLine() {
+    Print* previous = si->setOutput(&output);
+    si->run(line);
+    si->setOutput(previous);
+}
+
+bool RadioShell::nextFrame(ShellMessage& frame) {
+    if(!pending()) return false;
+
+    memset(&frame, 0, sizeof(frame));
+    while(frame.len < SHELL_CHUNK_SIZE) {
+        const uint8_t* chunk;
+        size_t n = output.peek(chunk);
+        if(n == 0) break;
+        if(n > (size_t) (SHELL_CHUNK_SIZE - frame.len)) n = SHELL_CHUNK_SIZE - frame.len;
+        memcpy(frame.text + frame.len, chunk, n);
+        output.consume(n);
+        frame.len += n;
+    }
+    if(frame.len > 0) out_seq++;
+    frame.seq = out_seq;
+    frame.ack = last_seq;
+    frame.flags = open ? RADIO_SHELL_FLAG_OPEN : 0;
+    ack_pending = false;
+    return true;
+}
+
+
+// ---------------BASE------------------ //
+
+RadioShellHost::RadioShellHost(Output output, uint32_t resend_timeout_ms)
+    : output{output}, resend_timeout_ms{resend_timeout_ms}
+{
+    memset(sessions, 0, sizeof(sessions));
+}
+
+void RadioShellHost::open(Radio::SSL_ID robot) {
+    if(robot >= RADIO_SHELL_MAX_ROBOTS) return;
+    Session& s = sessions[robot];
+    // seq keeps counting, so the robot can't mistake the new session for a resend of the old one
+    s.input_head = s.input_tail = 0;
+    s.waiting = false;
+    s.open = true;
+    s.first = true;
+    s.received_any = false;
+}
+
+void RadioShellHost::close(Radio::SSL_ID robot) {
+    if(robot >= RADIO_SHELL_MAX_ROBOTS) return;
+    sessions[robot].open = false;
+}
+
+bool RadioShellHost::isOpen(Radio::SSL_ID robot) const {
+    return robot < RADIO_SHELL_MAX_ROBOTS && sessions[robot].open;
+}
+
+size_t RadioShellHost::input(Radio::SSL_ID robot, const char* text, size_t len) {
+    if(robot >= RADIO_SHELL_MAX_ROBOTS || !sessions[robot].open) return 0;
+    Session& s = sessions[robot];
+    size_t n = 0;
+    while(n < len && (uint16_t) (s.input_head - s.input_tail) < RADIO_SHELL_INPUT_SIZE) {
+        s.input[s.input_head++ % RADIO_SHELL_INPUT_SIZE] = text[n++];
+    }
+    return n;
+}
+
+void RadioShellHost::handle(Radio::SSL_ID robot, const ShellMessage& frame, uint32_t now_ms) {
+    if(robot >= RADIO_SHELL_MAX_ROBOTS || !sessions[robot].open) return;
+    Session& s = sessions[robot];
+
+    if(!(frame.flags & RADIO_SHELL_FLAG_OPEN)) {
+        // Robot rebooted, open again with the frame that is in flight
+        s.first = true;
+        if(s.waiting) {
+            s.in_flight.flags |= RADIO_SHELL_FLAG_OPEN;
+            s.in_flight.seq = ++s.seq;
+        }
+        s.received_any = false;
+        return;
+    }
+
+    if(s.waiting && frame.ack == s.in_flight.seq) {
+        s.waiting = false;
+        s.first = false;
+    }
+
+    uint8_t len = frame.len > SHELL_CHUNK_SIZE ? SHELL_CHUNK_SIZE : frame.len;
+    if(len == 0) return;
+    if(s.received_any && frame.seq != s.expected) {
+        static const char LOST[] = "\n[output lost]\n";
+        if(output != nullptr) output(robot, LOST, sizeof(LOST) - 1);
+    }
+    s.expected = frame.seq + 1;
+    s.received_any = true;
+    s.active_ms = now_ms;
+    if(output != nullptr) output(robot, frame.text, len);
+}
+
+bool RadioShellHost::takeFrame(Radio::SSL_ID& robot, ShellMessage& frame, uint32_t now_ms) {
+    for(uint8_t i = 0; i < RADIO_SHELL_MAX_ROBOTS; i++) {
+        uint8_t r = (next_robot + i) % RADIO_SHELL_MAX_ROBOTS;
+        if(!sessions[r].open || !takeFrame(sessions[r], frame, now_ms)) continue;
+        robot = r;
+        next_robot = r + 1;
+        return true;
+    }
+    return false;
+}
+
+bool RadioShellHost::takeFrame(Session& s, ShellMessage& frame, uint32_t now_ms) {
+    if(now_ms - s.sent_ms < RADIO_SHELL_INTERVAL_MS) return false;
+
+    uint16_t available = s.input_head - s.input_tail;
+    if(s.waiting) {
+        // Stop and wait: resend, or poll so the robot has a slot to acknowledge in
+        if(now_ms - s.in_flight_ms >= resend_timeout_ms) {
+            frame = s.in_flight;
+            s.in_flight_ms = now_ms;
+        } else {
+            memset(&frame, 0, sizeof(frame));
+            frame.seq = s.seq;
+        }
+    } else if(available > 0 || s.first) {
+        memset(&frame, 0, sizeof(frame));
+        while(frame.len < SHELL_CHUNK_SIZE && s.input_tail != s.input_head) {
+            frame.text[frame.len++] = s.input[s.input_tail++ % RADIO_SHELL_INPUT_SIZE];
+        }
+        frame.seq = ++s.seq;
+        frame.flags = s.first ? RADIO_SHELL_FLAG_OPEN : 0;
+        s.in_flight = frame;
+        s.in_flight_ms = now_ms;
+        s.waiting = true;
+        s.active_ms = now_ms;
+    } else if(now_ms - s.active_ms < RADIO_SHELL_POLL_MS) {
+        memset(&frame, 0, sizeof(frame));
+        frame.seq = s.seq;
+    } else {
+        return false;
+    }
+    frame.ack = s.expected - 1;
+    s.sent_ms = now_ms;
+    return true;
+}
+
+} // namespace Radio
@@ -0,0 +1,116 @@
+// Delft Mercurians
+// 2026-10-19
+
+// SerialInterface over the radio link, so robots can be tuned from the base station
+//
+// The base station multiplexes one session per robot in a RadioShellHost. Command text goes to
+// the robot in ShellMessage frames, one frame in flight per robot, resent until the robot
+// acknowledges it. On the robot, a RadioShell runs complete lines on a SerialInterface with
+// its output redirected into a buffer, which is sent back in ack payload slots telemetry
+// leaves free (see CustomRF24_Robot::attachShell). Output is not resent, lost output frames
+// are shown as a marker in the output.
+//
+// Link use is bounded: the base sends at most one shell frame per robot per
+// RADIO_SHELL_INTERVAL_MS, which also gives the robot a slot to reply in.
+
+#pragma once
+#include <Arduino.h>
+#include "protocols_radio.h"
+#include "../serial/serial_interface.h"
+
+#ifndef RADIO_SHELL_INPUT_SIZE
+  #define RADIO_SHELL_INPUT_SIZE 128    // Command text queued per robot on the base station
+#endif
+#ifndef RADIO_SHELL_INTERVAL_MS
+  #define RADIO_SHELL_INTERVAL_MS 10
+#endif
+#ifndef RADIO_SHELL_POLL_MS
+  #define RADIO_SHELL_POLL_MS 500       // Keep polling for output this long after the last command
+#endif
+#ifndef RADIO_SHELL_MAX_ROBOTS
+  #define RADIO_SHELL_MAX_ROBOTS 16
+#endif
+
+namespace Radio {
+
+constexpr uint8_t SHELL_CHUNK_SIZE = sizeof(ShellMessage::text);
+
+// Robot side
+class RadioShell {
+    public:
+        RadioShell(SerialInterface* si) : si{si} { }
+
+        // Frame from the base station
+        void handle(const ShellMessage& frame);
+
+        // Output or acknowledge to send, false if there is nothing
+        bool pending() const { return ack_pending || output.used() > 0; }
+        bool nextFrame(ShellMessage& frame);
+
+    private:
+        SerialInterface* si;
+        OutputBuffer output;
+
+        char line[SERIAL_INTERFACE_LINE_LENGTH];
+        uint8_t line_len = 0;
+        bool line_too_long = false;
+
+        bool open = false;
+        uint8_t last_seq = 0;   // Last frame received in order
+        uint8_t out_seq = 0;
+        bool ack_pending = false;
+
+        void runLine();
+};
+
+
+// Base station side
+class RadioShellHost {
+    public:
+        static_assert((RADIO_SHELL_INPUT_SIZE & (RADIO_SHELL_INPUT_SIZE - 1)) == 0, "Size must be a power of 2");
+
+        typedef void (*Output)(Radio::SSL_ID robot, const char* text, uint8_t len);
+
+        RadioShellHost(Output output, uint32_t resend_timeout_ms = 50);
+
+        // Start a new session, the robot starts with an empty line
+        void open(Radio::SSL_ID robot);
+        void close(Radio::SSL_ID robot);
+        bool isOpen(Radio::SSL_ID robot) const;
+
+        // Queue command text, returns the number of bytes that fit
+        size_t input(Radio::SSL_ID robot, const char* text, size_t len);
+        size_t input(Radio::SSL_ID robot, const char* text) { return input(robot, text, strlen(text)); }
+
+        // Frame from a robot
+        void handle(Radio::SSL_ID robot, const ShellMessage& frame, uint32_t now_ms);
+
+        // Next frame to send to a robot, false if there is none
+        bool takeFrame(Radio::SSL_ID& robot, ShellMessage& frame, uint32_t now_ms);
+
+    private:
+        struct Session {
+            char input[RADIO_SHELL_INPUT_SIZE];
+            uint16_t input_head;
+            uint16_t input_tail;
+            ShellMessage in_flight;
+            bool waiting;           // in_flight is not acknowledged yet
+            bool open;
+            bool first;             // Next frame opens the session on the robot
+            bool received_any;
+            uint8_t seq;            // Next seq to send
+            uint8_t expected;       // Next output seq
+            uint32_t sent_ms;       // Last frame of any kind, for the rate limit
+            uint32_t in_flight_ms;  // Last time in_flight was sent
+            uint32_t active_ms;     // Last command or output
+        };
+
+        Output output;
+        uint32_t resend_timeout_ms;
+        Session sessions[RADIO_SHELL_MAX_ROBOTS];
+        uint8_t next_robot = 0;     // Round robin
+
+        bool takeFrame(Session& s, ShellMessage& frame, uint32_t now_ms);
+};
+
+} // namespace Radio
@@ -0,0 +1,63 @@
+#include "radio_trace.h"
+#include <string.h>
+
+namespace Radio {
+
+const char* TraceCollector::name(Latency l) {
+    switch(l) {
+        case DISPATCH: return "dispatch";
+        case HANDLER: return "handler";
+        case TO_CAN: return "can";
+        case ROBOT: return "robot";
+        case LINK: return "link";
+        default: return "";
+    }
+}
+
+TraceCollector::TraceCollector(uint16_t trace_every)
+    : trace_every{trace_every > 0 ? trace_every : (uint16_t) 1}
+{
+    memset(pending, 0, sizeof(pending));
+}
+
+void TraceCollector::tag(Radio::SSL_ID robot, uint8_t& trace_id, uint32_t now_us) {
+    trace_id = 0;
+    if(++counter < trace_every) return;
+    counter = 0;
+
+    trace_id = next_id;
+    next_id = next_id == UINT8_MAX ? 1 : next_id + 1;   // 0 is not traced
+    Pending& p = pending[trace_id % RADIO_TRACE_MAX_PENDING];
+    if(p.trace_id != 0) lost++;
+    p = Pending{trace_id, robot, now_us};
+}
+
+void TraceCollector::handle(Radio::SSL_ID robot, const TraceRecord& record, uint32_t now_us) {
+    Pending& p = pending[record.trace_id % RADIO_TRACE_MAX_PENDING];
+    if(record.trace_id == 0 || p.trace_id != record.trace_id || p.robot != robot) return;
+    p.trace_id = 0;
+
+    auto reached = [&](TraceStage s) { return (record.stages & (1 << (uint8_t) s)) != 0; };
+    auto at = [&](TraceStage s) { return record.stage_us[(uint8_t) s - 1]; };
+
+    if(reached(TraceStage::DISPATCHED)) latencies[DISPATCH].add(at(TraceStage::DISPATCHED));
+    if(reached(TraceStage::DISPATCHED) && reached(TraceStage::HANDLED)) {
+        latencies[HANDLER].add(at(TraceStage::HANDLED) - at(TraceStage::DISPATCHED));
+    }
+    if(reached(TraceStage::HANDLED) && reached(TraceStage::CAN_SENT)) {
+        latencies[TO_CAN].add(at(TraceStage::CAN_SENT) - at(TraceStage::HANDLED));
+    }
+    if(reached(TraceStage::QUEUED)) {
+        uint32_t robot_us = at(TraceStage::QUEUED);
+        uint32_t round_trip = now_us - p.sent_us;
+        latencies[ROBOT].add(robot_us);
+        if(round_trip >= robot_us) latencies[LINK].add(round_trip - robot_us);
+    }
+}
+
+void TraceCollector::reset() {
+    for(uint8_t i = 0; i < LATENCIES; i++) latencies[i].clear();
+    lost = 0;
+}
+
+} // namespace Radio
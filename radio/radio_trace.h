@@ -0,0 +1,72 @@
+// Delft Mercurians
+// 2026-10-19
+
+// Latency of commands from the base station to the wheels, per stage
+//
+// The base station tags one in every trace_every Command/GlobalCommand with a trace ID (only for
+// robots that advertise Radio::Capability::COMMAND_TRACE). The robot timestamps the traced
+// command when it is received, dispatched to the callback and handled, and when the firmware
+// marks the wheel command going out on CAN with CustomRF24_Robot::traceStage(). It then sends a
+// TraceRecord back, which the TraceCollector turns into a latency distribution per stage.
+//
+// The clocks are not synchronised, so the radio link is measured as a round trip: from sending
+// the command to receiving the record, minus the time the record was on the robot. That
+// includes waiting for the next packet to carry the record back in its ack payload.
+
+#pragma once
+#include <Arduino.h>
+#include "protocols_radio.h"
+#include "../profiler.h"
+
+#ifndef RADIO_TRACE_MAX_PENDING
+  #define RADIO_TRACE_MAX_PENDING 16    // Traces waiting for their record
+#endif
+#ifndef RADIO_TRACE_TIMEOUT_US
+  #define RADIO_TRACE_TIMEOUT_US 20000  // Robot sends the record without CAN_SENT after this
+#endif
+
+namespace Radio {
+
+// Base station side
+class TraceCollector {
+    public:
+        enum Latency : uint8_t {
+            DISPATCH,   // Received -> callback
+            HANDLER,    // Callback
+            TO_CAN,     // Callback returned -> wheel command on CAN
+            ROBOT,      // Received -> record queued
+            LINK,       // Round trip over the radio
+            LATENCIES,
+        };
+        static const char* name(Latency l);
+
+        TraceCollector(uint16_t trace_every = 16);
+
+        // Called for every command sent, sets trace_id (0 if this one is not traced)
+        void tag(Radio::SSL_ID robot, uint8_t& trace_id, uint32_t now_us);
+
+        // TraceRecord from a robot
+        void handle(Radio::SSL_ID robot, const TraceRecord& record, uint32_t now_us);
+
+        Profiler::Summary summary(Latency l) const { return l < LATENCIES ? latencies[l].summary() : Profiler::Summary{}; }
+
+        uint32_t lostCount() const { return lost; }     // Traces without a record
+
+        void reset();
+
+    private:
+        struct Pending {
+            uint8_t trace_id;   // 0 if free
+            Radio::SSL_ID robot;
+            uint32_t sent_us;
+        };
+
+        uint16_t trace_every;
+        uint16_t counter = 0;
+        uint8_t next_id = 1;
+        uint32_t lost = 0;
+        Pending pending[RADIO_TRACE_MAX_PENDING];
+        Profiler::Histogram latencies[LATENCIES];
+};
+
+} // namespace Radio
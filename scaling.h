@@ -11,4 +11,8 @@ constexpr float KICKER_VCAP = (260.0/UINT8_MAX);
 
 constexpr float CURRENT = (50.0/INT16_MAX);
 
+constexpr float HEADING = (3.14159265358979323846/INT16_MAX);
+constexpr float TRAJECTORY_SPEED = (4.0/511);     // 10 bit
+constexpr float TRAJECTORY_HEADING = (3.14159265358979323846/2048);  // 12 bit, wraps around at +-pi
+
 }
@@ -0,0 +1,140 @@
+// Delft Mercurians
+// 2026-10-19
+
+// Small number parser for serial commands, instead of atof/atoi/strtod
+//
+// Parses decimal integers and floats ("-12", "3.5", ".5e-3") in place, without allocating and
+// without pulling in the libc float parser. Floats are accurate to about 7 significant
+// digits, which is all a float holds anyway. Numbers may be separated by spaces or commas, and a
+// number followed by anything else ("12abc") is rejected.
+
+#pragma once
+#include <stdint.h>
+#include <limits>
+#include <type_traits>
+
+namespace NumberParse {
+
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+inline void skipSeparators(const char*& c) {
+    while(*c == ' ' || *c == ',' || *c == '\t') c++;
+}
+
+// A number has to end at a separator or the end of the line
+inline bool isEnd(char c) {
+    return c == '\0' || c == ' ' || c == ',' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Sign and digits of a magnitude up to max, or negative_max if negative. c is moved past the
+// number, false if there are no digits, it does not fit or it is followed by garbage
+inline bool parseMagnitude(const char*& c, bool& negative, uint32_t& n, uint32_t max, uint32_t negative_max) {
+    const char* p = c;
+    skipSeparators(p);
+    negative = *p == '-';
+    if(*p == '-' || *p == '+') p++;
+    if(!isDigit(*p)) return false;
+    uint32_t limit = negative ? negative_max : max;
+    n = 0;
+    while(isDigit(*p)) {
+        uint8_t d = *p++ - '0';
+        if(n > (limit - d) / 10 || d > limit) return false;  // Does not fit
+        n = n * 10 + d;
+    }
+    if(!isEnd(*p)) return false;
+    c = p;
+    return true;
+}
+
+inline bool parseFloat(const char*& c, float& v) {
+    static const float POW10[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f};
+    const char* p = c;
+    skipSeparators(p);
+    bool negative = *p == '-';
+    if(*p == '-' || *p == '+') p++;
+
+    // Up to 9 significant digits in an integer, the rest only shifts the exponent
+    uint32_t mantissa = 0;
+    int32_t exponent = 0;
+    uint8_t digits = 0;
+    bool any = false;
+    while(isDigit(*p)) {
+        if(digits < 9) {
+            mantissa = mantissa * 10 + (*p - '0');
+            if(mantissa != 0) digits++;
+        } else {
+            exponent++;
+        }
+        any = true;
+        p++;
+    }
+    if(*p == '.') {
+        p++;
+        while(isDigit(*p)) {
+            if(digits < 9) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if(mantissa != 0) digits++;
+                exponent--;
+            }
+            any = true;
+            p++;
+        }
+    }
+    if(!any) return false;
+
+    if(*p == 'e' || *p == 'E') {
+        const char* e = p + 1;
+        bool exp_negative = *e == '-';
+        if(*e == '-' || *e == '+') e++;
+        if(isDigit(*e)) {
+            int32_t exp10 = 0;
+            while(isDigit(*e)) {
+                if(exp10 < 1000) exp10 = exp10 * 10 + (*e - '0');   // Saturates far outside the float range
+                e++;
+            }
+            exponent += exp_negative ? -exp10 : exp10;
+            p = e;
+        }
+    }
+    if(!isEnd(*p)) return false;
+    // At most 9 digits in the mantissa, so beyond this the result is inf or 0 anyway
+    if(exponent > 64) exponent = 64;
+    if(exponent < -64) exponent = -64;
+
+    float f = mantissa;
+    while(exponent > 0) {
+        int32_t step = exponent > 9 ? 9 : exponent;
+        f *= POW10[step];
+        exponent -= step;
+    }
+    while(exponent < 0) {
+        int32_t step = -exponent > 9 ? 9 : -exponent;
+        f /= POW10[step];
+        exponent += step;
+    }
+    v = negative ? -f : f;
+    c = p;
+    return true;
+}
+
+// Parse any arithmetic type, false if the number does not fit in T
+template<typename T>
+bool parse(const char*& c, T& v) {
+    static_assert(std::is_arithmetic<T>::value, "Only numbers can be parsed");
+    if constexpr(std::is_floating_point<T>::value) {
+        float f;
+        if(!parseFloat(c, f)) return false;
+        v = f;
+    } else {
+        static_assert(sizeof(T) <= sizeof(uint32_t), "Integers are parsed as 32 bits");
+        constexpr uint32_t max = (uint32_t) std::numeric_limits<T>::max();
+        constexpr uint32_t negative_max = std::is_signed<T>::value ? max + 1 : 0;
+        bool negative;
+        uint32_t n;
+        if(!parseMagnitude(c, negative, n, max, negative_max)) return false;
+        v = negative ? (T) (0 - n) : (T) n;
+    }
+    return true;
+}
+
+} // namespace NumberParse
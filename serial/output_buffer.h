@@ -0,0 +1,82 @@
+// Delft Mercurians
+// 2026-10-19
+
+// Ring buffer in front of a serial port, so printing never waits for the host
+//
+// Everything printed to it is stored and written out later with flushTo(), as far as the port
+// can take it without blocking. A DMA driver can take the data with peek()/consume() instead.
+// When the buffer is full new output is dropped and counted.
+
+#pragma once
+#include <Arduino.h>
+
+#ifndef SERIAL_OUTPUT_BUFFER_SIZE
+  #define SERIAL_OUTPUT_BUFFER_SIZE 512
+#endif
+
+class OutputBuffer : public Print {
+    public:
+        static_assert((SERIAL_OUTPUT_BUFFER_SIZE & (SERIAL_OUTPUT_BUFFER_SIZE - 1)) == 0, "Size must be a power of 2");
+
+        size_t write(uint8_t c) override {
+            if(used() >= SERIAL_OUTPUT_BUFFER_SIZE) {
+                dropped++;
+                return 0;
+            }
+            data[head++ & MASK] = c;
+            return 1;
+        }
+
+        size_t write(const uint8_t* buffer, size_t size) override {
+            if(size > (size_t) availableForWrite()) {
+                // Keep records and lines whole, drop them entirely
+                dropped += size;
+                return 0;
+            }
+            for(size_t i = 0; i < size; i++) data[head++ & MASK] = buffer[i];
+            return size;
+        }
+
+        int availableForWrite() override { return SERIAL_OUTPUT_BUFFER_SIZE - used(); }
+
+        // Write buffered output to a port, at most max_bytes and only what it can take without blocking
+        size_t flushTo(Print& port, size_t max_bytes = SIZE_MAX) {
+            size_t room = port.availableForWrite();
+            if(room > max_bytes) room = max_bytes;
+            size_t written = 0;
+            while(written < room) {
+                const uint8_t* chunk;
+                size_t n = peek(chunk);
+                if(n == 0) break;
+                if(n > room - written) n = room - written;
+                n = port.write(chunk, n);
+                if(n == 0) break;
+                consume(n);
+                written += n;
+            }
+            return written;
+        }
+
+        // Contiguous block of buffered output, for DMA
+        size_t peek(const uint8_t*& chunk) const {
+            uint32_t start = tail & MASK;
+            size_t n = used();
+            if(n > SERIAL_OUTPUT_BUFFER_SIZE - start) n = SERIAL_OUTPUT_BUFFER_SIZE - start;
+            chunk = &data[start];
+            return n;
+        }
+
+        // Release bytes returned by peek() once they were sent
+        void consume(size_t n) { tail += n; }
+
+        size_t used() const { return head - tail; }
+        uint32_t droppedCount() const { return dropped; }
+
+    private:
+        static constexpr uint32_t MASK = SERIAL_OUTPUT_BUFFER_SIZE - 1;
+
+        uint8_t data[SERIAL_OUTPUT_BUFFER_SIZE];
+        volatile uint32_t head = 0;    // Free running, written by print
+        volatile uint32_t tail = 0;    // Free running, written by flushTo/consume (may be a DMA interrupt)
+        uint32_t dropped = 0;
+};
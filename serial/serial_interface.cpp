@@ -3,57 +3,63 @@
 SerialInterface::SerialInterface(Stream* s, char name) {
     this->s = s;
     this->name = name;
+    memset(command_index, NO_COMMAND, sizeof(command_index));
 }
 
 void SerialInterface::initFuns() {
     this->add('?', &SerialInterface::printHelp, this, "Print commands");
-    this->add('e', SerialInterface::echo, "Echo");
+    this->add('e', &SerialInterface::echo, this, "Echo");
+    this->add('$', &SerialInterface::streamCommand, this, "Stream values in binary: $<commands> <Hz>, $ to stop");
     #ifdef VERSION_SHORT
-    this->add('v', SerialInterface::printVersion, "Version");
+    this->add('v', &SerialInterface::printVersion, this, "Version");
     #endif
     #ifdef PROTOCOL_VERSION
-    this->add('#', SerialInterface::printProtocolVersion, "Protocol version");
+    this->add('#', &SerialInterface::printProtocolVersion, this, "Protocol version");
     #endif
 }
 
-void SerialInterface::add(char command, void (*function) (char*), String help) {
+void SerialInterface::add(char command, void (*function) (char*), const char* help) {
     Function fun;
     fun.typ = FunctionType::CharPointer;
     fun.fun_charptr = function;
     fun.help = help;
     fun.subcommand = false;
     fun.si = this; // Just in case
-    fun_map[command] = fun;
+    store(command, fun);
 }
 
 
-void SerialInterface::add(char command, void (*function) (float), String help) {
+void SerialInterface::add(char command, void (*function) (float), const char* help) {
     Function fun;
     fun.typ = FunctionType::Float;
     fun.fun_float = function;
     fun.help = help;
     fun.subcommand = false;
     fun.si = this; // Just in case
-    fun_map[command] = fun;
+    store(command, fun);
 }
 
 void SerialInterface::readFloatAndRun(char* c, void (*function) (float)) {
-    float f = atof(c);
+    const char* p = c;
+    float f = 0;
+    NumberParse::parse(p, f);
     function(f);
 }
 
-void SerialInterface::add(char command, void (*function) (int), String help) {
+void SerialInterface::add(char command, void (*function) (int), const char* help) {
     Function fun;
     fun.typ = FunctionType::Int;
     fun.fun_int = function;
     fun.help = help;
     fun.subcommand = false;
     fun.si = this; // Just in case
-    fun_map[command] = fun;
+    store(command, fun);
 }
 
 void SerialInterface::readIntAndRun(char* c, void (*function) (int)) {
-    int i = atoi(c);
+    const char* p = c;
+    int i = 0;
+    NumberParse::parse(p, i);
     function(i);
 }
 
@@ -68,100 +74,129 @@ void SerialInterface::handleValue(char *c, T* v) {
 
 template<typename T>
 void SerialInterface::printValue(T v) {
-    Serial.println(v);
+    out().println(v);
 }
 
 template<>
 void SerialInterface::setValue<float>(char *c, float* v) {
-    *v = atof(c);
+    const char* p = c;
+    float f = 0;
+    NumberParse::parse(p, f);
+    *v = f;
 }
 
 template<>
 void SerialInterface::setValue<int>(char *c, int* v) {
-    *v = atoi(c);
+    const char* p = c;
+    int i = 0;
+    NumberParse::parse(p, i);
+    *v = i;
 }
 
-void SerialInterface::add(char command, float* val, String help) {
+void SerialInterface::add(char command, float* val, const char* help) {
     Function fun;
     fun.typ = FunctionType::SetFloat;
     fun.ref_float = val;
     fun.help = help;
     fun.subcommand = false;
     fun.si = this; // Just in case
-    fun_map[command] = fun;
+    store(command, fun);
 }
 
-void SerialInterface::add(char command, int* val, String help) {
+void SerialInterface::add(char command, int* val, const char* help) {
     Function fun;
     fun.typ = FunctionType::SetInt;
     fun.ref_int = val;
     fun.help = help;
     fun.subcommand = false;
     fun.si = this; // Just in case
-    fun_map[command] = fun;
-}
-
-// void SerialInterface::add(char command, void (*function) (float*, size_t), String help) {
-//     Function fun;
-//     fun.typ = FunctionType::FloatPointer;
-//     fun.fun_floatptr = function;
-//     fun.help = help;
-//     fun.subcommand = false;
-//     fun.si = this; // Just in case
-//     fun_map[command] = fun;
-//     Serial.println("Adding function.");
-// }
-
-// void SerialInterface::readFloatsAndRun(char* c, void (*function) (float*, size_t)) {
-//     float f[20];
-//     uint8_t i;
-//     for(i = 0; i < 20; i++){
-// 		f[i] = atof(c);
-// 		while(*(c++) == ' '){}
-// 		while(*c != ' '){
-// 			if(*c == '\n' || *c == '\r' || *c == 0){
-// 				goto run;
-// 			}
-// 			c++;
-// 		}
-// 		c++;
-// 	}
-//     run:
-//     function(f, i);
-// }
-
-
-void SerialInterface::add(char command, void (SerialInterface::*mem_function) (char*), SerialInterface* si, String help) {
+    store(command, fun);
+}
+
+void SerialInterface::addGeneric(char command, void (*function) (), bool (*invoke) (void (*) (), const char*), const char* help) {
+    Function fun;
+    fun.typ = FunctionType::Generic;
+    fun.fun_generic = function;
+    fun.invoke = invoke;
+    fun.help = help;
+    fun.subcommand = false;
+    fun.si = this; // Just in case
+    store(command, fun);
+}
+
+
+void SerialInterface::add(char command, void (SerialInterface::*mem_function) (char*), SerialInterface* si, const char* help) {
     Function fun;
     fun.typ = FunctionType::Member_CharPointer;
     fun.fun_member_charptr = mem_function;
     fun.si = si;
     fun.help = help;
     fun.subcommand = false;
-    fun_map[command] = fun;
+    store(command, fun);
 }
 
-void SerialInterface::add(char command, SerialInterface* si, String help) {
+void SerialInterface::add(char command, SerialInterface* si, const char* help) {
     this->add(command, &SerialInterface::run, si, help);
-    fun_map[command].subcommand = true;
+    si->parent = this;
+    Function* fun = slot(command);
+    if(fun != nullptr) fun->subcommand = true;
+}
+
+SerialInterface::Function* SerialInterface::slot(char command) {
+    uint8_t c = (uint8_t) command;
+    if(c >= sizeof(command_index)) return nullptr;
+    if(command_index[c] == NO_COMMAND) {
+        if(num_functions >= SERIAL_INTERFACE_MAX_COMMANDS) return nullptr;
+        command_index[c] = num_functions++;
+    }
+    return &functions[command_index[c]];
+}
+
+void SerialInterface::store(char command, const Function& fun) {
+    Function* f = slot(command);
+    if(f == nullptr) {
+        out().printf("Can't add command [%c], increase SERIAL_INTERFACE_MAX_COMMANDS\n", command);
+        return;
+    }
+    *f = fun;
 }
 
 
 void SerialInterface::printHelp(char* c) {
-    printHelp();
+    // Printed by the top interface, which is the one that is run
+    SerialInterface* r = root();
+    out().println("Commands:");
+    r->help[0] = HelpLevel{this, 0};
+    r->help_depth = 1;
+    r->help_out = &out();
+    r->continueHelp();
 }
 
-void SerialInterface::printHelp(String indentation) {
-    if(indentation == ""){
-        Serial.println("Commands:");
-    }
-    for (auto const& it : fun_map){
-        Function fun = it.second;
-        Serial.print(indentation);
-        Serial.printf("[%c] ", it.first);
-        Serial.println(fun.help);
-        if(fun.subcommand){
-            fun.si->printHelp(indentation + String("  "));
+void SerialInterface::continueHelp() {
+    // Straight to the port blocks anyway, buffers are filled as far as they have room
+    bool blocking = help_out == &port();
+    while(help_depth > 0) {
+        HelpLevel& level = help[help_depth - 1];
+
+        // In order of command character
+        uint8_t c = level.next;
+        while(c < sizeof(command_index) && level.si->command_index[c] == NO_COMMAND) c++;
+        if(c == sizeof(command_index)) {
+            help_depth--;
+            continue;
+        }
+        const Function& fun = level.si->functions[level.si->command_index[c]];
+
+        size_t len = 2 * (help_depth - 1) + 4 + strlen(fun.help) + 2;
+        bool fits = help_out->availableForWrite() >= (int) len || len > SERIAL_OUTPUT_BUFFER_SIZE;
+        if(!blocking && !fits) return;  // Rest in the next run()
+        for(uint8_t i = 1; i < help_depth; i++) help_out->print("  ");
+        help_out->printf("[%c] ", c);
+        help_out->println(fun.help);
+
+        level.next = c + 1;
+        if(fun.subcommand && help_depth < SERIAL_INTERFACE_MAX_DEPTH) {
+            help[help_depth++] = HelpLevel{fun.si, 0};
         }
     }
 }
@@ -170,15 +205,15 @@ void SerialInterface::printHelp(String indentation) {
 void SerialInterface::run(char* c) {
     if(isTerminator(c[0])) return;
 
-    auto item = fun_map.find(c[0]);
-    if(item == fun_map.end()) {
+    uint8_t i = (uint8_t) c[0] < sizeof(command_index) ? command_index[(uint8_t) c[0]] : NO_COMMAND;
+    if(i == NO_COMMAND) {
         // Command is not known
-        Serial.printf("Unknown command: [%c]\n", c[0]);
+        out().printf("Unknown command: [%c]\n", c[0]);
         return;
     }
 
     // Serial.printf("[%c] Running command [%c]\n", name, c[0]);
-    Function fun = item->second;
+    const Function& fun = functions[i];
     switch(fun.typ){
         case FunctionType::CharPointer:
             fun.fun_charptr(c+1);
@@ -189,9 +224,9 @@ void SerialInterface::run(char* c) {
         case FunctionType::Float:
             readFloatAndRun(c+1, fun.fun_float);
             break;
-        // case FunctionType::FloatPointer:
-        //     readFloatsAndRun(c+1, fun.fun_floatptr);
-        //     break;
+        case FunctionType::Generic:
+            if(!fun.invoke(fun.fun_generic, c+1)) out().printf("Invalid arguments for [%c]\n", c[0]);
+            break;
         case FunctionType::Int:
             readIntAndRun(c+1, fun.fun_int);
             break;
@@ -202,25 +237,134 @@ void SerialInterface::run(char* c) {
             handleValue(c+1, fun.ref_int);
             break;
         default:
-            Serial.println("Unhandled FunctionType");
+            out().println("Unhandled FunctionType");
     }
     
     
 }
 
 void SerialInterface::run() {
-    if(s == nullptr) return;
-    while(s->available() && bufi < 50){
+    run(UINT32_MAX, SIZE_MAX);
+}
+
+void SerialInterface::run(uint32_t budget_us, size_t budget_bytes) {
+    uint32_t start = micros();
+    size_t bytes = 0;
+    if(output_buffer != nullptr) bytes += output_buffer->flushTo(port(), budget_bytes);
+    continueHelp();
+
+    // Unread input stays in the receive buffer of the port until the next call
+    while(s != nullptr && s->available() && bytes < budget_bytes && micros() - start < budget_us){
         char c = s->read();
-        buffer[bufi++] = c;
+        bytes++;
         if(isTerminator(c)){
-            run(buffer);
+            if(line_too_long) {
+                out().printf("Line too long, max %d characters\n", SERIAL_INTERFACE_LINE_LENGTH - 1);
+                line_too_long = false;
+            } else {
+                buffer[bufi] = c;
+                run(buffer);
+            }
             bufi = 0;
+        } else if(bufi < SERIAL_INTERFACE_LINE_LENGTH - 1) {
+            buffer[bufi++] = c;
+        } else if(!line_too_long) {
+            line_too_long = true;   // Skip the rest of the line
+            lines_too_long++;
         }
     }
-    if(bufi == 50){
-        bufi = 0;
+    streamValues();
+    if(output_buffer != nullptr && bytes < budget_bytes) output_buffer->flushTo(port(), budget_bytes - bytes);
+
+    uint32_t dt = micros() - start;
+    if(dt > max_run_us) max_run_us = dt;
+}
+
+
+static_assert(sizeof(int) == 4 && sizeof(float) == 4, "Streamed values are 4 bytes");
+
+void SerialInterface::streamCommand(char* c) {
+    streaming.count = 0;
+    streaming.types = 0;
+    for(; !isTerminator(*c) && *c != ' '; c++) {
+        uint8_t i = (uint8_t) *c < sizeof(command_index) ? command_index[(uint8_t) *c] : NO_COMMAND;
+        if(i == NO_COMMAND || (functions[i].typ != FunctionType::SetFloat && functions[i].typ != FunctionType::SetInt)) {
+            out().printf("Can't stream [%c], not a value\n", *c);
+            streaming.count = 0;
+            return;
+        }
+        if(streaming.count >= SERIAL_STREAM_MAX_VALUES) {
+            out().printf("Can't stream more than %d values\n", SERIAL_STREAM_MAX_VALUES);
+            streaming.count = 0;
+            return;
+        }
+        if(functions[i].typ == FunctionType::SetInt) streaming.types |= 1 << streaming.count;
+        streaming.slots[streaming.count++] = i;
+    }
+
+    const char* p = c;
+    int rate = 0;
+    NumberParse::parse(p, rate);
+    if(streaming.count == 0 || rate <= 0) {
+        streaming.count = 0;
+        out().println("Streaming stopped");
+        return;
+    }
+    if(rate > SERIAL_STREAM_MAX_RATE) rate = SERIAL_STREAM_MAX_RATE;
+    streaming.period_us = 1000000 / rate;
+    streaming.next_us = micros();
+    streaming.seq = 0;
+    streaming.skipped = 0;
+    out().printf("Streaming %d values at %d Hz\n", streaming.count, rate);
+}
+
+void SerialInterface::streamValues() {
+    if(streaming.count > 0) {
+        uint32_t now = micros();
+        if((int32_t) (now - streaming.next_us) >= 0) {
+            // Periods that were missed count as dropped records on the host
+            uint32_t behind = (now - streaming.next_us) / streaming.period_us;
+            streaming.seq += behind;
+            streaming.next_us += (behind + 1) * streaming.period_us;
+
+            uint32_t values[SERIAL_STREAM_MAX_VALUES];
+            for(uint8_t i = 0; i < streaming.count; i++) {
+                const Function& fun = functions[streaming.slots[i]];
+                memcpy(&values[i], fun.typ == FunctionType::SetInt ? (void*) fun.ref_int : (void*) fun.ref_float, 4);
+            }
+            uint8_t record[SerialStream::recordSize(SERIAL_STREAM_MAX_VALUES)];
+            size_t len = SerialStream::encode(record, streaming.seq++, now, streaming.types, values, streaming.count);
+
+            // Never block the loop, skip the record if it doesn't fit
+            if(out().availableForWrite() < (int) len) {
+                streaming.skipped++;
+            } else {
+                out().write(record, len);
+            }
+        }
     }
+
+    // Subcommand interfaces are only run through this one
+    for(uint8_t i = 0; i < num_functions; i++) {
+        if(functions[i].subcommand && functions[i].si != this) functions[i].si->streamValues();
+    }
+}
+
+SerialInterface* SerialInterface::root() {
+    SerialInterface* r = this;
+    while(r->parent != nullptr) r = r->parent;
+    return r;
+}
+
+Print& SerialInterface::port() {
+    SerialInterface* r = root();
+    return r->s != nullptr ? (Print&) *r->s : (Print&) Serial;
+}
+
+Print& SerialInterface::out() {
+    SerialInterface* r = root();
+    if(r->output_override != nullptr) return *r->output_override;
+    return r->output_buffer != nullptr ? (Print&) *r->output_buffer : port();
 }
 
 
@@ -230,24 +374,24 @@ bool SerialInterface::isTerminator(char c) {
 
 void SerialInterface::echo(char* c) {
 	while(*c != '\n' && *c != '\r' && *c != 0) {
-		Serial.print(*c);
+		out().print(*c);
 		c++;
 	}
-	Serial.println();
+	out().println();
 }
 
 
 void SerialInterface::printVersion(char* c) {
     #ifdef VERSION_SHORT
-    Serial.print(VERSION_SHORT);
-    Serial.print('\n');
+    out().print(VERSION_SHORT);
+    out().print('\n');
     #endif
 }
 
 void SerialInterface::printProtocolVersion(char* c) {
     #ifdef PROTOCOL_VERSION
-    Serial.print(PROTOCOL_VERSION);
-    Serial.print('\n');
+    out().print(PROTOCOL_VERSION);
+    out().print('\n');
     #endif
 }
 
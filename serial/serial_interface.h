@@ -1,6 +1,10 @@
 #pragma once
-#include <map>
 #include <Arduino.h>
+#include "serial_stream.h"
+#include "output_buffer.h"
+#include "number_parse.h"
+#include <tuple>
+#include <utility>
 #if __has_include("version.h")
     #include "version.h"
 #endif
@@ -8,34 +12,87 @@
     #include "../libversion.h"
 #endif
 
+// Maximum number of commands per interface (subcommand interfaces have their own)
+#ifndef SERIAL_INTERFACE_MAX_COMMANDS
+  #define SERIAL_INTERFACE_MAX_COMMANDS 24
+#endif
+// Longest command line, including the terminator
+#ifndef SERIAL_INTERFACE_LINE_LENGTH
+  #define SERIAL_INTERFACE_LINE_LENGTH 50
+#endif
+// Maximum nesting of subcommand interfaces in the help
+#ifndef SERIAL_INTERFACE_MAX_DEPTH
+  #define SERIAL_INTERFACE_MAX_DEPTH 4
+#endif
 
+
+// Commands are looked up directly by character, help texts are string literals (flash), nothing is allocated
 class SerialInterface {
     public:
         SerialInterface(Stream* s = nullptr, char name = 'm');
 
         void initFuns();
 
-        void add(char command, void (*function) (char*), String help = "");
-        void add(char command, void (*function) (float), String help = "");
-        void add(char command, void (*function) (int), String help = "");
-        void add(char command, float*, String help = "");
-        void add(char command, int*, String help = "");
-        // void add(char command, void (*function) (float*, size_t), String help = "");
-
-        void add(char command, void (SerialInterface::*) (char*), SerialInterface*, String help = "");
-        void add(char command, SerialInterface*, String help = "");
+        void add(char command, void (*function) (char*), const char* help = "");
+        void add(char command, void (*function) (float), const char* help = "");
+        void add(char command, void (*function) (int), const char* help = "");
+        void add(char command, float*, const char* help = "");
+        void add(char command, int*, const char* help = "");
+
+        // Any number of numeric arguments, e.g. void (*) (float, float, int): "p1.5 2 3"
+        // Arguments are separated by spaces or commas, the function is not called if one is missing
+        template<typename... Args>
+        void add(char command, void (*function) (Args...), const char* help = "") {
+            addGeneric(command, (void (*) ()) function, &SerialInterface::parseAndRun<Args...>, help);
+        }
+
+        void add(char command, void (SerialInterface::*) (char*), SerialInterface*, const char* help = "");
+        void add(char command, SerialInterface*, const char* help = "");
         void run(char* c);
         void run();
-        
+
+        // Like run(), but returns after budget_us or budget_bytes of input and output,
+        // and continues where it left off in the next call
+        void run(uint32_t budget_us, size_t budget_bytes = SIZE_MAX);
+
+        // Print through a buffer that is flushed by run(), instead of straight to the port
+        // The buffer of the top interface is used by all its subcommand interfaces
+        void setOutputBuffer(OutputBuffer* buffer) { output_buffer = buffer; }
+
+        // Send replies somewhere else (e.g. a remote session) instead, nullptr to go back to normal
+        // Returns the previous one
+        Print* setOutput(Print* output) { Print* previous = output_override; output_override = output; return previous; }
+
+        // Longest time spent in run() [us]
+        uint32_t maxRunTime() const { return max_run_us; }
+
+        // Lines that were ignored because they didn't fit in the buffer
+        uint32_t linesTooLong() const { return lines_too_long; }
+
     protected:
         void printHelp(char* c);
-        void printHelp(String indentation = "");
-        std::map<char, String> help_map;
+
+        // Where replies go: the output set with setOutput on the top interface, its output buffer or its port
+        Print& out();
 
         void readFloatAndRun(char* c, void (*function) (float));
-        // void readFloatsAndRun(char* c, void (*function) (float*, size_t));
         void readIntAndRun(char* c, void (*function) (int));
 
+        void addGeneric(char command, void (*function) (), bool (*invoke) (void (*) (), const char*), const char* help);
+
+        template<typename... Args>
+        static bool parseAndRun(void (*function) (), const char* c) {
+            std::tuple<typename std::decay<Args>::type...> args;
+            if(!parseArguments(c, args, std::index_sequence_for<Args...>{})) return false;
+            std::apply((void (*) (Args...)) function, args);
+            return true;
+        }
+
+        template<typename Tuple, size_t... I>
+        static bool parseArguments(const char* c, Tuple& args, std::index_sequence<I...>) {
+            return (NumberParse::parse(c, std::get<I>(args)) && ...);
+        }
+
         template<typename T>
         void handleValue(char *c, T* v);
 
@@ -47,15 +104,24 @@ class SerialInterface {
 
     private:
         Stream* s;
+        SerialInterface* parent = nullptr;  // Interface this one is a subcommand of
+        OutputBuffer* output_buffer = nullptr;
+        Print* output_override = nullptr;
+        uint32_t max_run_us = 0;
+
+        SerialInterface* root();
+        Print& port();
 
-        char buffer[50];
-        size_t bufi;
+        char buffer[SERIAL_INTERFACE_LINE_LENGTH];
+        size_t bufi = 0;
+        bool line_too_long = false;
+        uint32_t lines_too_long = 0;
 
         bool isTerminator(char c);
 
         char name;
 
-        static void echo(char* c);
+        void echo(char* c);
 
         enum class FunctionType {
             CharPointer,
@@ -64,7 +130,7 @@ class SerialInterface {
             Int,
             SetFloat,
             SetInt,
-            // FloatPointer,
+            Generic,
         };
 
         struct Function {
@@ -76,17 +142,52 @@ class SerialInterface {
                 void (*fun_int) (int);
                 float* ref_float;
                 int* ref_int;
-                // void (*fun_floatptr) (float*, size_t);
+                void (*fun_generic) ();
             };
-            String help;
+            bool (*invoke) (void (*) (), const char*);  // Parses the arguments and calls fun_generic
+            const char* help;
             SerialInterface* si;
             bool subcommand;
         };
 
-        std::map<char, Function> fun_map;
+        static constexpr uint8_t NO_COMMAND = 0xFF;
+        static_assert(SERIAL_INTERFACE_MAX_COMMANDS < NO_COMMAND);
+
+        uint8_t command_index[128];     // Slot in functions per command character
+        Function functions[SERIAL_INTERFACE_MAX_COMMANDS];
+        uint8_t num_functions = 0;
+
+        // Slot of a command, a new one if it is not there yet
+        // nullptr if the table is full or the character is not ASCII
+        Function* slot(char command);
+        void store(char command, const Function& fun);
+
+        // Binary streaming of value commands, see serial_stream.h
+        struct Streaming {
+            uint8_t slots[SERIAL_STREAM_MAX_VALUES];    // Function slots of the streamed values
+            uint8_t count = 0;
+            uint8_t types = 0;
+            uint16_t seq = 0;
+            uint32_t period_us = 0;
+            uint32_t next_us = 0;
+            uint32_t skipped = 0;   // Records not sent because the output buffer was full
+        } streaming;
+
+        void streamCommand(char* c);
+        void streamValues();
+
+        // Help is printed a line at a time, as far as it fits in the output buffer
+        struct HelpLevel {
+            SerialInterface* si;
+            uint8_t next;   // Next command character
+        };
+        HelpLevel help[SERIAL_INTERFACE_MAX_DEPTH];
+        uint8_t help_depth = 0;     // 0 when not printing help
+        Print* help_out = nullptr;  // Where help was asked from, can be a remote session
+        void continueHelp();
 
-        static void printVersion(char* c);
-        static void printProtocolVersion(char* c);
+        void printVersion(char* c);
+        void printProtocolVersion(char* c);
 
 
 
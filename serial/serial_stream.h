@@ -0,0 +1,175 @@
+// Delft Mercurians
+// 2026-10-19
+
+// Binary telemetry records streamed by SerialInterface ($ command), and a decoder for the host
+//
+// Record layout (little endian):
+//   0xA5 0x5A          sync
+//   uint8_t  count     number of values
+//   uint8_t  types     bit per value, 1 = int32_t, 0 = float
+//   uint16_t seq       sequence number, also incremented for records that could not be sent
+//   uint32_t time      micros() at sampling
+//   4 * count bytes    values
+//   uint8_t  crc       CRC-8 (poly 0x07) over everything after the sync bytes
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifndef SERIAL_STREAM_MAX_VALUES
+  #define SERIAL_STREAM_MAX_VALUES 8
+#endif
+#ifndef SERIAL_STREAM_MAX_RATE
+  #define SERIAL_STREAM_MAX_RATE 1000   // [Hz] Full records at this rate already need about 43 kB/s
+#endif
+
+namespace SerialStream {
+
+constexpr uint8_t SYNC0 = 0xA5;
+constexpr uint8_t SYNC1 = 0x5A;
+constexpr size_t HEADER_SIZE = 2 + 1 + 1 + 2 + 4;
+
+static_assert(SERIAL_STREAM_MAX_VALUES <= 8, "Value types are a single byte");
+
+inline constexpr size_t recordSize(uint8_t count) {
+    return HEADER_SIZE + 4 * count + 1;
+}
+
+inline uint8_t crc8(const uint8_t* data, size_t len, uint8_t crc = 0) {
+    for(size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for(uint8_t b = 0; b < 8; b++) {
+            crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+// Write a record to buf (at least recordSize(count) bytes), returns its size
+inline size_t encode(uint8_t* buf, uint16_t seq, uint32_t time_us, uint8_t types, const uint32_t* values, uint8_t count) {
+    buf[0] = SYNC0;
+    buf[1] = SYNC1;
+    buf[2] = count;
+    buf[3] = types;
+    memcpy(&buf[4], &seq, 2);
+    memcpy(&buf[6], &time_us, 4);
+    memcpy(&buf[HEADER_SIZE], values, 4 * count);
+    size_t len = HEADER_SIZE + 4 * count;
+    buf[len] = crc8(&buf[2], len - 2);
+    return len + 1;
+}
+
+
+struct Record {
+    uint16_t seq;
+    uint32_t time_us;
+    uint8_t count;
+    uint8_t types;
+    uint32_t raw[SERIAL_STREAM_MAX_VALUES];
+
+    bool isInt(uint8_t i) const { return types & (1 << i); }
+    float asFloat(uint8_t i) const { float f; memcpy(&f, &raw[i], 4); return f; }
+    int32_t asInt(uint8_t i) const { return (int32_t) raw[i]; }
+    double value(uint8_t i) const { return isInt(i) ? asInt(i) : asFloat(i); }
+};
+
+// Host side: feed it every byte from the serial port, text in between records is skipped
+class Decoder {
+    public:
+        // Returns true when a valid record was completed, it is then available in record()
+        // After a corrupted record, bytes already fed can hold more records: call next() until it
+        // returns false before feeding the next byte, or they come out of the following feed() calls
+        bool feed(uint8_t byte) {
+            if(pending_len >= sizeof(pending)) pending_len = pending_pos = 0;  // Can't happen, see pending
+            pending[pending_len++] = byte;
+            return next();
+        }
+
+        bool next() {
+            while(pending_pos < pending_len) {
+                if(step(pending[pending_pos++])) return true;
+            }
+            pending_len = pending_pos = 0;
+            return false;
+        }
+
+        const Record& record() const { return current; }
+
+        uint32_t receivedCount() const { return received; }
+        uint32_t droppedCount() const { return dropped; }      // Gaps in the sequence numbers
+        uint32_t errorCount() const { return errors; }         // Corrupted records
+
+    private:
+        uint8_t buf[recordSize(SERIAL_STREAM_MAX_VALUES)];
+        size_t len = 0;
+        // Bytes still to be run: the new byte, and after a corrupted record what was buffered after
+        // its sync. Everything after a completed record stays in here, so buf and pending
+        // together never hold more than a record and the new byte.
+        uint8_t pending[recordSize(SERIAL_STREAM_MAX_VALUES) + 1];
+        size_t pending_len = 0;
+        size_t pending_pos = 0;
+        Record current = {};
+        uint16_t last_seq = 0;
+        uint32_t received = 0;
+        uint32_t dropped = 0;
+        uint32_t errors = 0;
+
+        bool step(uint8_t byte) {
+            if(len == 0) {
+                if(byte == SYNC0) buf[len++] = byte;
+                return false;
+            }
+            if(len == 1) {
+                if(byte == SYNC1) {
+                    buf[len++] = byte;
+                } else {
+                    len = byte == SYNC0 ? 1 : 0;
+                }
+                return false;
+            }
+            buf[len++] = byte;
+            if(len == 3 && byte > SERIAL_STREAM_MAX_VALUES) {
+                resync();   // The count can be the sync of the next record
+                return false;
+            }
+            if(len < HEADER_SIZE || len < recordSize(buf[2])) return false;
+
+            size_t end = recordSize(buf[2]) - 1;
+            if(crc8(&buf[2], end - 2) != buf[end]) {
+                resync();
+                return false;
+            }
+            len = 0;
+
+            current.count = buf[2];
+            current.types = buf[3];
+            memcpy(&current.seq, &buf[4], 2);
+            memcpy(&current.time_us, &buf[6], 4);
+            memcpy(current.raw, &buf[HEADER_SIZE], 4 * current.count);
+
+            if(received > 0) dropped += (uint16_t) (current.seq - last_seq - 1);
+            last_seq = current.seq;
+            received++;
+            return true;
+        }
+
+        // Bad record, run what was buffered after its sync again, before the rest of pending
+        void resync() {
+            errors++;
+            for(size_t i = 1; i < len; i++) {
+                if(buf[i] != SYNC0) continue;
+                size_t n = len - i;
+                size_t rest = pending_len - pending_pos;
+                if(n + rest > sizeof(pending)) break;
+                memmove(&pending[n], &pending[pending_pos], rest);
+                memcpy(pending, &buf[i], n);
+                pending_pos = 0;
+                pending_len = n + rest;
+                break;
+            }
+            len = 0;
+        }
+};
+
+} // namespace SerialStream
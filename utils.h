@@ -168,6 +168,10 @@ enum class Variable : uint8_t {
     THRESHOLD_BATTERY_LOW = 0x2C,
     THRESHOLD_BATTERY_CRITICAL = 0x2D,
 
+    LOOP_TIME_AVG = 0x2E,       // [us] Read only, see profiler.h
+    LOOP_TIME_P99 = 0x2F,       // [us]
+    LOOP_TIME_MAX = 0x30,       // [us]
+
     TRIGGER_SAVE = 0x31,
 
     SAS_Kp_yaw = 0x40,
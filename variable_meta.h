@@ -0,0 +1,143 @@
+// Delft Mercurians
+// 2026-10-19
+
+// Type, range and unit of every HG::Variable
+//
+// CustomRF24_Robot::registerVariable<var>() checks at compile time that the registered variable
+// has this type, and WRITE/SET_DEFAULT clamp values to the range (non-finite floats are
+// rejected). The table is constexpr, so a check is an index into flash and a compare.
+// Variables without metadata (VariableType::VOID) are not checked.
+//
+// Limits are what the robot can physically use, so a typo or a gain pushed mid-match by an
+// order of magnitude is clamped instead of applied.
+
+#pragma once
+#include <stdint.h>
+#include <limits>
+#include <type_traits>
+#include "utils.h"
+
+namespace HG {
+
+struct VariableMeta {
+    VariableType type;  // VOID if there is no metadata
+    float min;          // Of the stored value
+    float max;
+    const char* unit;
+};
+
+constexpr float UNLIMITED = std::numeric_limits<float>::infinity();
+
+// Type of a registered C++ variable, VOID if it has none
+template<typename T>
+constexpr VariableType variableType() {
+    if constexpr(std::is_enum<T>::value) {
+        return variableType<typename std::underlying_type<T>::type>();
+    } else if constexpr(std::is_same<T, float>::value) {
+        return VariableType::F32;
+    } else if constexpr(std::is_same<T, bool>::value || std::is_same<T, uint8_t>::value) {
+        return VariableType::U8;
+    } else if constexpr(std::is_integral<T>::value) {
+        constexpr bool s = std::is_signed<T>::value;
+        switch(sizeof(T)) {
+            case 1: return s ? VariableType::I8 : VariableType::U8;
+            case 2: return s ? VariableType::I16 : VariableType::U16;
+            case 4: return s ? VariableType::I32 : VariableType::U32;
+        }
+    }
+    return VariableType::VOID;
+}
+
+// Motor driver variables are CAN_VARIABLE_TYPE (float). Limits of the traction and dribbler drivers
+constexpr VariableMeta MD_LIM_META[2][3] = {
+    {{VariableType::F32, 0, 15, "A"}, {VariableType::F32, 0, 24, "V"}, {VariableType::F32, 0, 600, "rad/s"}},
+    {{VariableType::F32, 0, 5, "A"}, {VariableType::F32, 0, 24, "V"}, {VariableType::F32, 0, 2500, "rad/s"}},
+};
+
+// P, I, D, output ramp, output limit and LPF time constant of each loop, shared by both drivers.
+// The velocity loop outputs a current (foc_current torque control), the angle loop a speed
+constexpr VariableMeta MD_PID_META[4][6] = {
+    {{VariableType::F32, 0, 50, ""}, {VariableType::F32, 0, 5000, ""}, {VariableType::F32, 0, 1, ""},  // Current D
+     {VariableType::F32, 0, 1e6, "V/s"}, {VariableType::F32, 0, 24, "V"}, {VariableType::F32, 0, 0.1, "s"}},
+    {{VariableType::F32, 0, 50, ""}, {VariableType::F32, 0, 5000, ""}, {VariableType::F32, 0, 1, ""},  // Current Q
+     {VariableType::F32, 0, 1e6, "V/s"}, {VariableType::F32, 0, 24, "V"}, {VariableType::F32, 0, 0.1, "s"}},
+    {{VariableType::F32, 0, 10, ""}, {VariableType::F32, 0, 100, ""}, {VariableType::F32, 0, 1, ""},   // Velocity
+     {VariableType::F32, 0, 1e4, "A/s"}, {VariableType::F32, 0, 15, "A"}, {VariableType::F32, 0, 0.1, "s"}},
+    {{VariableType::F32, 0, 100, ""}, {VariableType::F32, 0, 100, ""}, {VariableType::F32, 0, 10, ""},  // Angle
+     {VariableType::F32, 0, 1e4, "rad/s^2"}, {VariableType::F32, 0, 600, "rad/s"}, {VariableType::F32, 0, 0.1, "s"}},
+};
+
+constexpr VariableMeta variableMeta(Variable v) {
+    constexpr VariableMeta NONE = {VariableType::VOID, -UNLIMITED, UNLIMITED, ""};
+
+    switch(v) {
+        case Variable::RADIO_CHANNEL:
+        case Variable::RADIO_CHANNEL_ALT:
+        case Variable::RADIO_CHANNEL_DEBUG:
+            return {VariableType::U8, 0, 125, ""};  // nRF24 channels
+
+        case Variable::LOG_LEVEL_SERIAL:
+        case Variable::LOG_LEVEL_RADIO:
+        case Variable::LOG_LEVEL_SD:
+            return {VariableType::U8, 0, 4, ""};    // Radio::LogLevel
+
+        case Variable::LOOP_TIME_AVG:
+        case Variable::LOOP_TIME_P99:
+        case Variable::LOOP_TIME_MAX:
+            return {VariableType::U32, 0, UNLIMITED, "us"};
+
+        case Variable::SAS_Kp_yaw:
+        case Variable::SAS_Fallback_Kp_yaw:
+            return {VariableType::F32, 0, 50, "1/s"};
+        case Variable::SAS_Kd_yaw:
+        case Variable::SAS_Fallback_Kd_yaw:
+            return {VariableType::F32, 0, 5, ""};
+        case Variable::SAS_max_yaw_speed:
+        case Variable::SAS_Fallback_max_yaw_speed:
+            return {VariableType::F32, 0, 30, "rad/s"};
+        case Variable::SAS_max_yaw_accel:
+        case Variable::SAS_Fallback_max_yaw_accel:
+            return {VariableType::F32, 0, 200, "rad/s^2"};
+        case Variable::SAS_max_lin_speed:
+        case Variable::SAS_Fallback_max_lin_speed:
+            return {VariableType::F32, 0, 5, "m/s"};
+        case Variable::SAS_max_lin_accel:
+        case Variable::SAS_Fallback_max_lin_accel:
+            return {VariableType::F32, 0, 10, "m/s^2"};
+        case Variable::SAS_gain_scheduling_threshold:
+            return {VariableType::F32, 0, 30, "rad/s"};
+        case Variable::SAS_gain_scheduling_multiplier:
+            return {VariableType::F32, 0, 10, ""};
+
+        default:
+            break;
+    }
+
+    constexpr Variable MD_FIRST[] = {Variable::MD_TRACTION_LIM_C, Variable::MD_DRIBBLER_LIM_C};
+    for(uint8_t d = 0; d < 2; d++) {
+        uint8_t offset = (uint8_t) v - (uint8_t) MD_FIRST[d];
+        if(offset < 3) return MD_LIM_META[d][offset];
+        if(offset < 3 + 4 * 6) return MD_PID_META[(offset - 3) / 6][(offset - 3) % 6];
+    }
+
+    return NONE;
+}
+
+struct VariableMetaTable {
+    VariableMeta meta[256];
+
+    constexpr VariableMetaTable() : meta{} {
+        for(uint16_t i = 0; i < 256; i++) meta[i] = variableMeta((Variable) i);
+    }
+
+    constexpr const VariableMeta& operator[](Variable v) const { return meta[(uint8_t) v]; }
+};
+
+inline constexpr VariableMetaTable VARIABLE_META;
+
+static_assert(VARIABLE_META[Variable::MD_TRACTION_PID_V_P].type == VariableType::F32);
+static_assert(VARIABLE_META[Variable::MD_DRIBBLER_PID_A_F].max == 0.1f);
+static_assert(VARIABLE_META[Variable::MD_TRACTION_RESERVED_1].type == VariableType::VOID);
+static_assert(variableType<float>() == VariableType::F32 && variableType<int16_t>() == VariableType::I16);
+
+} // namespace HG